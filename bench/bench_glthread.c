@@ -0,0 +1,242 @@
+/* Old NULL terminated glthread list against the circular sentinel list.
+ *
+ * The old implementation is reproduced here as it was, kept out of line and
+ * unspecialised so comp_fn stays an indirect call, as it was from glthread.c. Measured on the operations the free block lists use:
+ * a full walk, counting, remove + priority insert churn on a list kept
+ * sorted by size, and LIFO push/pop.
+ */
+#include <stdint.h>
+#include <assert.h>
+#include "glueThread/glthread.h"
+#include "bench_util.h"
+
+#define N_NODES     1024
+#define N_WALKS     20000
+#define N_CHURN     2000000
+
+typedef struct bench_node_{
+    uint32_t key;
+    glthread_t glue;
+}bench_node_t;
+
+static bench_node_t old_nodes[N_NODES];
+static bench_node_t new_nodes[N_NODES];
+static uint32_t churn_keys[N_CHURN];
+static uint32_t churn_index[N_CHURN];
+
+/* ---- the NULL terminated list, before the rework ---- */
+#define OLD_ITERATE_BEGIN(start, curr)                                  \
+{                                                                       \
+    glthread_t *glthread_tmp = NULL;                                    \
+    curr = (start)->right;                                              \
+    for(; curr != NULL; curr = glthread_tmp){                           \
+        glthread_tmp = (curr)->right;
+
+#define OLD_ITERATE_END }}
+
+__attribute__((noinline, noclone)) static void old_init_glthread(glthread_t *glthread)
+{
+    glthread->left = NULL;
+    glthread->right = NULL;
+}
+
+__attribute__((noinline, noclone)) static void old_glthread_add_next(glthread_t *curr_glthread, glthread_t *new_glthread)
+{
+    if(!curr_glthread->right){
+        new_glthread->left = curr_glthread;
+        curr_glthread->right = new_glthread;
+        return;
+    }
+    glthread_t *temp = curr_glthread->right;
+    curr_glthread->right = new_glthread;
+    new_glthread->left = curr_glthread;
+    new_glthread->right = temp;
+    temp->left = new_glthread;
+}
+
+__attribute__((noinline, noclone)) static void old_remove_glthread(glthread_t *curr_glthread)
+{
+    if(!curr_glthread->left){
+        if(curr_glthread->right){
+            curr_glthread->right->left = NULL;
+            curr_glthread->right = NULL;
+        }
+        return;
+    }
+    if(!curr_glthread->right){
+        curr_glthread->left->right = NULL;
+        curr_glthread->left = NULL;
+        return;
+    }
+    curr_glthread->left->right = curr_glthread->right;
+    curr_glthread->right->left = curr_glthread->left;
+    curr_glthread->left = NULL;
+    curr_glthread->right = NULL;
+}
+
+__attribute__((noinline, noclone)) static unsigned int old_get_glthread_list_count(glthread_t *glthread_head)
+{
+    glthread_t *curr;
+    unsigned int count = 0U;
+
+    OLD_ITERATE_BEGIN(glthread_head, curr){
+        count++;
+    }OLD_ITERATE_END;
+    return count;
+}
+
+__attribute__((noinline, noclone)) static void old_glthread_priority_insert(glthread_t *glthread_head, glthread_t *glthread,
+    int (*comp_fn)(void *, void *), int offset)
+{
+    glthread_t *curr = NULL;
+    glthread_t *prev = NULL;
+
+    old_init_glthread(glthread);
+    if(!glthread_head->right && !glthread_head->left){
+        old_glthread_add_next(glthread_head, glthread);
+        return;
+    }
+    if(glthread_head->right && !glthread_head->right->right){
+        if(comp_fn(GLTHREAD_GET_USER_DATA_FROM_OFFSET(glthread_head->right, offset),
+                GLTHREAD_GET_USER_DATA_FROM_OFFSET(glthread, offset)) == -1)
+            old_glthread_add_next(glthread_head->right, glthread);
+        else
+            old_glthread_add_next(glthread_head, glthread);
+        return;
+    }
+    if(comp_fn(GLTHREAD_GET_USER_DATA_FROM_OFFSET(glthread, offset),
+            GLTHREAD_GET_USER_DATA_FROM_OFFSET(glthread_head->right, offset)) == -1){
+        old_glthread_add_next(glthread_head, glthread);
+        return;
+    }
+    OLD_ITERATE_BEGIN(glthread_head, curr){
+        if(comp_fn(GLTHREAD_GET_USER_DATA_FROM_OFFSET(glthread, offset),
+                GLTHREAD_GET_USER_DATA_FROM_OFFSET(curr, offset)) != -1){
+            prev = curr;
+            continue;
+        }
+        old_glthread_add_next(prev ? prev : glthread_head, glthread);
+        return;
+    }OLD_ITERATE_END;
+    old_glthread_add_next(prev, glthread);
+}
+/* ---- end of the old list ---- */
+
+/* bigger first, like the free block lists */
+static int bench_node_compare(void *a, void *b)
+{
+    uint32_t x = ((bench_node_t *)a)->key;
+    uint32_t y = ((bench_node_t *)b)->key;
+
+    if(x > y)
+        return -1;
+    return x < y;
+}
+
+static uint32_t bench_rand(void)
+{
+    static uint32_t state = 2463534242U;
+
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+static void bench_report(const char *label, uint64_t old_ns, uint64_t new_ns, uint64_t ops)
+{
+    printf("%-30s old %8.1f ns/op  new %8.1f ns/op  (%.2fx)\n", label,
+           (double)old_ns / ops, (double)new_ns / ops, (double)old_ns / new_ns);
+}
+
+int main(void)
+{
+    glthread_t old_head;
+    glthread_list_t new_list;
+    glthread_t *curr = NULL;
+    uint64_t t0, old_ns, new_ns;
+    uint64_t sum = 0U;
+    int i, n;
+
+    old_init_glthread(&old_head);
+    init_glthread_list(&new_list);
+    for(i = 0; i < N_NODES; i++){
+        old_nodes[i].key = new_nodes[i].key = bench_rand() % 4096U;
+        old_glthread_priority_insert(&old_head, &old_nodes[i].glue, bench_node_compare,
+                                     offsetof(bench_node_t, glue));
+        init_glthread(&new_nodes[i].glue);
+        glthread_list_priority_insert(&new_list, &new_nodes[i].glue, bench_node_compare,
+                                      offsetof(bench_node_t, glue));
+    }
+    for(i = 0; i < N_CHURN; i++){
+        churn_index[i] = bench_rand() % N_NODES;
+        churn_keys[i] = bench_rand() % 4096U;
+    }
+
+    t0 = bench_now_ns();
+    for(n = 0; n < N_WALKS; n++){
+        OLD_ITERATE_BEGIN(&old_head, curr){
+            sum += ((bench_node_t *)GLTHREAD_GET_USER_DATA_FROM_OFFSET(curr, offsetof(bench_node_t, glue)))->key;
+        }OLD_ITERATE_END;
+    }
+    old_ns = bench_now_ns() - t0;
+    t0 = bench_now_ns();
+    for(n = 0; n < N_WALKS; n++){
+        ITERATE_GLTHREAD_BEGIN(&new_list.head, curr){
+            sum += ((bench_node_t *)GLTHREAD_GET_USER_DATA_FROM_OFFSET(curr, offsetof(bench_node_t, glue)))->key;
+        }ITERATE_GLTHREAD_END(&new_list.head, curr);
+    }
+    new_ns = bench_now_ns() - t0;
+    bench_report("walk, per node", old_ns, new_ns, (uint64_t)N_WALKS * N_NODES);
+
+    t0 = bench_now_ns();
+    for(n = 0; n < N_WALKS; n++)
+        sum += old_get_glthread_list_count(&old_head);
+    old_ns = bench_now_ns() - t0;
+    t0 = bench_now_ns();
+    for(n = 0; n < N_WALKS; n++){
+        __asm__ volatile("" : : "r"(&new_list) : "memory");
+        sum += glthread_list_count(&new_list);
+    }
+    new_ns = bench_now_ns() - t0;
+    bench_report("count", old_ns, new_ns ? new_ns : 1U, N_WALKS);
+
+    t0 = bench_now_ns();
+    for(i = 0; i < N_CHURN; i++){
+        old_remove_glthread(&old_nodes[churn_index[i]].glue);
+        old_nodes[churn_index[i]].key = churn_keys[i];
+        old_glthread_priority_insert(&old_head, &old_nodes[churn_index[i]].glue, bench_node_compare,
+                                     offsetof(bench_node_t, glue));
+    }
+    old_ns = bench_now_ns() - t0;
+    t0 = bench_now_ns();
+    for(i = 0; i < N_CHURN; i++){
+        glthread_list_remove(&new_list, &new_nodes[churn_index[i]].glue);
+        new_nodes[churn_index[i]].key = churn_keys[i];
+        glthread_list_priority_insert(&new_list, &new_nodes[churn_index[i]].glue, bench_node_compare,
+                                      offsetof(bench_node_t, glue));
+    }
+    new_ns = bench_now_ns() - t0;
+    bench_report("remove + priority insert", old_ns, new_ns, N_CHURN);
+
+    /* object cache free lists: push on free, pop on allocation */
+    t0 = bench_now_ns();
+    for(i = 0; i < N_CHURN; i++){
+        curr = old_head.right;
+        old_remove_glthread(curr);
+        old_glthread_add_next(&old_head, curr);
+    }
+    old_ns = bench_now_ns() - t0;
+    t0 = bench_now_ns();
+    for(i = 0; i < N_CHURN; i++){
+        curr = glthread_list_dequeue_first(&new_list);
+        glthread_list_add_first(&new_list, curr);
+    }
+    new_ns = bench_now_ns() - t0;
+    bench_report("dequeue first + add first", old_ns, new_ns, N_CHURN);
+
+    /* both lists went through the same operations */
+    assert(old_get_glthread_list_count(&old_head) == glthread_list_count(&new_list));
+    printf("(checksum %lu)\n", (unsigned long)sum);
+    return 0;
+}
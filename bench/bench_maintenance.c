@@ -0,0 +1,65 @@
+/* Tail latency of xcalloc()/xfree() with and without the maintenance thread.
+ *
+ * Each round grows a family by BENCH_PAGES vm pages and then frees
+ * everything, so the application thread keeps hitting mmap() on the way up
+ * and munmap() on the way down. With the maintenance thread running those
+ * pages come from the prefaulted ready pool and go to the retired list.
+ */
+#include <unistd.h>
+#include "uapi_mm.h"
+#include "bench_util.h"
+
+#define BENCH_ROUNDS    200
+#define BENCH_OBJECTS   4096
+
+typedef struct bench_obj_{
+    char payload[240];
+}bench_obj_t;
+
+static uint64_t alloc_ns[BENCH_ROUNDS * BENCH_OBJECTS];
+static uint64_t free_ns[BENCH_ROUNDS * BENCH_OBJECTS];
+static void *objects[BENCH_OBJECTS];
+
+static void bench_run(const char *label, vm_page_family_t *vm_page_family)
+{
+    char line[64];
+    size_t n = 0;
+    uint64_t t0;
+    int round, i;
+
+    for(round = 0; round < BENCH_ROUNDS; round++){
+        for(i = 0; i < BENCH_OBJECTS; i++, n++){
+            t0 = bench_now_ns();
+            objects[i] = xcalloc_page_family(vm_page_family, 1);
+            alloc_ns[n] = bench_now_ns() - t0;
+        }
+        n -= BENCH_OBJECTS;
+        for(i = 0; i < BENCH_OBJECTS; i++, n++){
+            t0 = bench_now_ns();
+            xfree(objects[i]);
+            free_ns[n] = bench_now_ns() - t0;
+        }
+        /* give the maintenance thread a period to catch up, as a real workload would */
+        usleep(2000);
+    }
+    snprintf(line, sizeof(line), "%s xcalloc", label);
+    bench_print_percentiles(line, alloc_ns, n);
+    snprintf(line, sizeof(line), "%s xfree", label);
+    bench_print_percentiles(line, free_ns, n);
+}
+
+int main(void)
+{
+    vm_page_family_t *inline_family = NULL;
+    vm_page_family_t *maintained_family = NULL;
+
+    mm_init();
+    inline_family = mm_instantiate_new_page_family("bench_inline", sizeof(bench_obj_t));
+    maintained_family = mm_instantiate_new_page_family("bench_maintained", sizeof(bench_obj_t));
+
+    bench_run("inline", inline_family);
+    mm_maintenance_start(1U);
+    bench_run("maintenance", maintained_family);
+    mm_maintenance_stop();
+    return 0;
+}
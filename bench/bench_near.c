@@ -0,0 +1,128 @@
+/* Linked list traversal, nodes from XCALLOC() against XCALLOC_NEAR().
+ *
+ * N_LISTS lists grow round robin out of a family whose pages are reserved up
+ * front, as a long running program's would be after some churn. Plain
+ * xcalloc() takes the biggest free block, which is on a different page almost
+ * every time. The near variant puts a list's next node on its previous node's
+ * vm page while that has room, then on the pages next to it on the family's
+ * page list. With N_LISTS lists growing side by side a page fills up after
+ * about one node per list, so most hops still cross a system page; what the
+ * hint buys shows as hops landing within NEAR_PAGES system pages. Each list
+ * is then walked in turn.
+ */
+#include <unistd.h>
+#include "uapi_mm.h"
+#include "bench_util.h"
+
+#define N_LISTS         32
+#define N_PER_LIST      2048
+#define N_WALKS         20
+#define NEAR_PAGES      8U
+
+typedef struct plain_node_{
+    uint64_t value;
+    struct plain_node_ *next;
+    char payload[48];
+}plain_node_t;
+
+/* same layout, its own family */
+typedef struct near_node_{
+    uint64_t value;
+    struct near_node_ *next;
+    char payload[48];
+}near_node_t;
+
+static plain_node_t *plain_heads[N_LISTS];
+static near_node_t *near_heads[N_LISTS];
+
+static void bench_report(const char *label, uint64_t build_ns, uint64_t walk_ns, uint64_t page_switches,
+    uint64_t near_hops)
+{
+    uint64_t nodes = (uint64_t)N_LISTS * N_PER_LIST;
+
+    printf("%-14s build %6.1f ns/node  walk %6.2f ns/node  system page switches %5.1f%% of hops"
+           "  within %u pages %5.1f%%\n", label,
+           (double)build_ns / nodes, (double)walk_ns / (nodes * N_WALKS),
+           100.0 * page_switches / nodes, NEAR_PAGES, 100.0 * near_hops / nodes);
+}
+
+static inline vm_bool_t bench_is_near(void *a, void *b)
+{
+    uintptr_t distance = (uintptr_t)a > (uintptr_t)b ? (uintptr_t)a - (uintptr_t)b : (uintptr_t)b - (uintptr_t)a;
+
+    return distance <= NEAR_PAGES * (uintptr_t)getpagesize() ? MM_TRUE : MM_FALSE;
+}
+
+int main(void)
+{
+    plain_node_t *plain_tails[N_LISTS] = {NULL};
+    near_node_t *near_tails[N_LISTS] = {NULL};
+    plain_node_t *plain = NULL;
+    near_node_t *near = NULL;
+    uintptr_t page_mask = ~((uintptr_t)getpagesize() - 1);
+    uint64_t t0, build_ns, walk_ns, switches, near_hops, sum = 0U;
+    int i, l, w;
+
+    mm_init();
+    mm_reserve(MM_REG_STRUCT(plain_node_t), N_LISTS * N_PER_LIST);
+    mm_reserve(MM_REG_STRUCT(near_node_t), N_LISTS * N_PER_LIST);
+
+    t0 = bench_now_ns();
+    for(i = 0; i < N_PER_LIST; i++){
+        for(l = 0; l < N_LISTS; l++){
+            plain = XCALLOC(1, plain_node_t);
+            plain->value = i;
+            if(plain_tails[l])
+                plain_tails[l]->next = plain;
+            else
+                plain_heads[l] = plain;
+            plain_tails[l] = plain;
+        }
+    }
+    build_ns = bench_now_ns() - t0;
+    t0 = bench_now_ns();
+    for(w = 0; w < N_WALKS; w++)
+        for(l = 0; l < N_LISTS; l++)
+            for(plain = plain_heads[l]; plain; plain = plain->next)
+                sum += plain->value;
+    walk_ns = bench_now_ns() - t0;
+    switches = near_hops = 0U;
+    for(l = 0; l < N_LISTS; l++){
+        for(plain = plain_heads[l]; plain->next; plain = plain->next){
+            switches += ((uintptr_t)plain & page_mask) != ((uintptr_t)plain->next & page_mask);
+            near_hops += bench_is_near(plain, plain->next);
+        }
+    }
+    bench_report("XCALLOC", build_ns, walk_ns, switches, near_hops);
+
+    t0 = bench_now_ns();
+    for(i = 0; i < N_PER_LIST; i++){
+        for(l = 0; l < N_LISTS; l++){
+            near = XCALLOC_NEAR(near_tails[l], 1, near_node_t);
+            near->value = i;
+            if(near_tails[l])
+                near_tails[l]->next = near;
+            else
+                near_heads[l] = near;
+            near_tails[l] = near;
+        }
+    }
+    build_ns = bench_now_ns() - t0;
+    t0 = bench_now_ns();
+    for(w = 0; w < N_WALKS; w++)
+        for(l = 0; l < N_LISTS; l++)
+            for(near = near_heads[l]; near; near = near->next)
+                sum += near->value;
+    walk_ns = bench_now_ns() - t0;
+    switches = near_hops = 0U;
+    for(l = 0; l < N_LISTS; l++){
+        for(near = near_heads[l]; near->next; near = near->next){
+            switches += ((uintptr_t)near & page_mask) != ((uintptr_t)near->next & page_mask);
+            near_hops += bench_is_near(near, near->next);
+        }
+    }
+    bench_report("XCALLOC_NEAR", build_ns, walk_ns, switches, near_hops);
+
+    printf("(checksum %lu)\n", (unsigned long)sum);
+    return 0;
+}
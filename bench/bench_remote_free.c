@@ -0,0 +1,94 @@
+/* Producer/consumer throughput: one thread allocates, another frees.
+ *
+ * "deferred" is the default remote free path, the consumer pushes onto the
+ * family's lock free stack and the producer drains it on its next xcalloc().
+ * "mutex" turns deferral off and serialises both threads on one lock, what a
+ * caller has to do without it.
+ */
+#include <pthread.h>
+#include <sched.h>
+#include "uapi_mm.h"
+#include "bench_util.h"
+
+#define BENCH_OBJECTS   (1U << 21)
+#define RING_SIZE       1024U
+
+typedef struct bench_msg_{
+    uint64_t seq;
+    char payload[56];
+}bench_msg_t;
+
+/* single producer single consumer ring of objects in flight */
+static void *ring[RING_SIZE];
+static uint32_t ring_head = 0U;
+static uint32_t ring_tail = 0U;
+
+static vm_page_family_t *bench_family = NULL;
+static vm_bool_t use_mutex = MM_FALSE;
+static pthread_mutex_t bench_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void *producer_fn(void *arg)
+{
+    uint32_t head = 0U;
+    void *object = NULL;
+
+    (void)arg;
+    for(head = 0U; head < BENCH_OBJECTS; head++){
+        while(head - __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE) == RING_SIZE)
+            sched_yield();
+        if(use_mutex)
+            pthread_mutex_lock(&bench_mutex);
+        object = xcalloc_page_family(bench_family, 1);
+        if(use_mutex)
+            pthread_mutex_unlock(&bench_mutex);
+        ring[head % RING_SIZE] = object;
+        __atomic_store_n(&ring_head, head + 1U, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void *consumer_fn(void *arg)
+{
+    uint32_t tail = 0U;
+
+    (void)arg;
+    for(tail = 0U; tail < BENCH_OBJECTS; tail++){
+        while(__atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) == tail)
+            sched_yield();
+        if(use_mutex)
+            pthread_mutex_lock(&bench_mutex);
+        xfree(ring[tail % RING_SIZE]);
+        if(use_mutex)
+            pthread_mutex_unlock(&bench_mutex);
+        __atomic_store_n(&ring_tail, tail + 1U, __ATOMIC_RELEASE);
+    }
+    return NULL;
+}
+
+static void bench_run(const char *label, char *family_name, vm_bool_t mutex)
+{
+    pthread_t producer, consumer;
+    uint64_t t0, elapsed;
+
+    bench_family = mm_instantiate_new_page_family(family_name, sizeof(bench_msg_t));
+    use_mutex = mutex;
+    mm_set_remote_free_mode(mutex ? MM_FALSE : MM_TRUE);
+    ring_head = ring_tail = 0U;
+
+    t0 = bench_now_ns();
+    pthread_create(&producer, NULL, producer_fn, NULL);
+    pthread_create(&consumer, NULL, consumer_fn, NULL);
+    pthread_join(producer, NULL);
+    pthread_join(consumer, NULL);
+    elapsed = bench_now_ns() - t0;
+    printf("%-28s %8.2f Mops/s  (%u objects, %.1f ns per alloc+free)\n", label,
+           BENCH_OBJECTS * 1000.0 / elapsed, BENCH_OBJECTS, (double)elapsed / BENCH_OBJECTS);
+}
+
+int main(void)
+{
+    mm_init();
+    bench_run("remote free deferred", "bench_msg_deferred", MM_FALSE);
+    bench_run("remote free mutex", "bench_msg_mutex", MM_TRUE);
+    return 0;
+}
@@ -0,0 +1,74 @@
+/* What the shard mutex costs a sharded family's xcalloc()/xfree() pair.
+ *
+ * "owned" is a general family allocated and freed by its owner thread, no
+ * lock at all. "sharded" takes the home shard's mutex on both calls and
+ * looks up the CPU in the rseq area. "lock pair" is just two uncontended
+ * lock/unlock pairs, the most a restartable sequence could take off.
+ */
+#include <pthread.h>
+#include "uapi_mm.h"
+#include "bench_util.h"
+
+#define BENCH_BATCH     64U
+#define BENCH_SAMPLES   (1U << 15)
+
+typedef struct bench_obj_{
+    uint64_t key;
+    char payload[56];
+}bench_obj_t;
+
+static uint64_t samples[BENCH_SAMPLES];
+static pthread_mutex_t bench_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* ns per xcalloc()/xfree() pair, timed a batch at a time */
+static void bench_family(const char *label, vm_page_family_t *vm_page_family)
+{
+    void *objects[BENCH_BATCH];
+    uint64_t t0;
+    uint32_t n, i;
+
+    for(n = 0U; n < BENCH_SAMPLES; n++){
+        t0 = bench_now_ns();
+        for(i = 0U; i < BENCH_BATCH; i++)
+            objects[i] = xcalloc_page_family(vm_page_family, 1);
+        for(i = 0U; i < BENCH_BATCH; i++)
+            xfree(objects[i]);
+        samples[n] = (bench_now_ns() - t0) / BENCH_BATCH;
+    }
+    bench_print_percentiles(label, samples, BENCH_SAMPLES);
+}
+
+static void bench_lock_pair(void)
+{
+    uint64_t t0;
+    uint32_t n, i;
+
+    for(n = 0U; n < BENCH_SAMPLES; n++){
+        t0 = bench_now_ns();
+        for(i = 0U; i < BENCH_BATCH; i++){
+            pthread_mutex_lock(&bench_mutex);
+            pthread_mutex_unlock(&bench_mutex);
+            pthread_mutex_lock(&bench_mutex);
+            pthread_mutex_unlock(&bench_mutex);
+        }
+        samples[n] = (bench_now_ns() - t0) / BENCH_BATCH;
+    }
+    bench_print_percentiles("lock pair", samples, BENCH_SAMPLES);
+}
+
+int main(void)
+{
+    vm_page_family_t *owned = NULL;
+    vm_page_family_t *sharded = NULL;
+
+    mm_init();
+    owned = mm_instantiate_new_page_family("bench_owned_obj_t", sizeof(bench_obj_t));
+    sharded = mm_instantiate_new_sharded_family("bench_sharded_obj_t", sizeof(bench_obj_t), 0U);
+    mm_reserve(owned, BENCH_BATCH);
+    mm_reserve(sharded, BENCH_BATCH * sharded->shard_count);
+
+    bench_family("owned", owned);
+    bench_family("sharded", sharded);
+    bench_lock_pair();
+    return 0;
+}
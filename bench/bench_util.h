@@ -0,0 +1,36 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+/* Timing helpers shared by the benchmarks under bench/, run with `make bench` */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <time.h>
+
+static inline uint64_t bench_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static int bench_u64_compare(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return (x > y) - (x < y);
+}
+
+/* Sorts samples in place and prints p50/p99/p99.9/max */
+static inline void bench_print_percentiles(const char *label, uint64_t *samples, size_t n)
+{
+    qsort(samples, n, sizeof(uint64_t), bench_u64_compare);
+    printf("%-28s p50 %6lu ns  p99 %6lu ns  p99.9 %7lu ns  max %8lu ns\n", label,
+           (unsigned long)samples[n / 2], (unsigned long)samples[n * 99 / 100],
+           (unsigned long)samples[n * 999 / 1000], (unsigned long)samples[n - 1]);
+}
+
+#endif /* BENCH_UTIL_H */
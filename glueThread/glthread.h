@@ -1,46 +1,144 @@
 #ifndef GL_THREAD_H
 #define GL_THREAD_H
 
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Circular intrusive doubly linked list. A list head is a sentinel glthread
+ * pointing at itself when empty, a node that is on no list points at itself
+ * too, so linking and unlinking never test for NULL neighbours.
+ */
 typedef struct glthread_{
     struct glthread_ *left;
     struct glthread_ *right;
 }glthread_t;
 
-void init_glthread(glthread_t *glthread);
-
-void glthread_add_next(glthread_t *curr_glthread, glthread_t *new_glthread);
-
-void glthread_add_before(glthread_t *curr_glthread, glthread_t *new_glthread);
-
-void glthread_add_last(glthread_t *glthread_head, glthread_t *new_glthread);
-
-void remove_glthread(glthread_t *glthread);
+/* A sentinel that also keeps its length, for O(1) counts */
+typedef struct glthread_list_{
+    glthread_t head;
+    unsigned int count;
+}glthread_list_t;
+
+static inline void init_glthread(glthread_t *glthread)
+{
+    glthread->left  = glthread;
+    glthread->right = glthread;
+}
+
+static inline void glthread_add_next(glthread_t *curr_glthread, glthread_t *new_glthread)
+{
+    glthread_t *next = curr_glthread->right;
+
+    new_glthread->left = curr_glthread;
+    new_glthread->right = next;
+    next->left = new_glthread;
+    curr_glthread->right = new_glthread;
+}
+
+static inline void glthread_add_before(glthread_t *curr_glthread, glthread_t *new_glthread)
+{
+    glthread_add_next(curr_glthread->left, new_glthread);
+}
+
+static inline void glthread_add_last(glthread_t *glthread_head, glthread_t *new_glthread)
+{
+    glthread_add_next(glthread_head->left, new_glthread);
+}
+
+/* Safe on a node that is on no list, it stays a self loop */
+static inline void remove_glthread(glthread_t *glthread)
+{
+    glthread->left->right = glthread->right;
+    glthread->right->left = glthread->left;
+    glthread->left = glthread;
+    glthread->right = glthread;
+}
+
+static inline glthread_t *dequeue_glthread_first(glthread_t *base_glthread)
+{
+    glthread_t *first = base_glthread->right;
+
+    if(first == base_glthread)
+        return NULL;
+    remove_glthread(first);
+    return first;
+}
 
 void delete_glthread_list(glthread_t *glthread_head);
 
+/* Walks the list, glthread_list_count() is the O(1) one */
 unsigned int get_glthread_list_count(glthread_t *glthread_head);
 
+/* Inserts ahead of the first node comp_fn() ranks below the new one
+ * (comp_fn(new, node) == -1), behind all of its equals */
 void glthread_priority_insert(glthread_t *glthread_head, glthread_t *glthread,
                                 int (*comp_fn)(void *, void *), int offset);
 
-glthread_t *dequeue_glthread_first(glthread_t *base_glthread);
-
-
+static inline void init_glthread_list(glthread_list_t *list)
+{
+    init_glthread(&list->head);
+    list->count = 0U;
+}
+
+static inline unsigned int glthread_list_count(glthread_list_t *list)
+{
+    return list->count;
+}
+
+static inline void glthread_list_add_first(glthread_list_t *list, glthread_t *new_glthread)
+{
+    glthread_add_next(&list->head, new_glthread);
+    list->count++;
+}
+
+static inline void glthread_list_add_last(glthread_list_t *list, glthread_t *new_glthread)
+{
+    glthread_add_last(&list->head, new_glthread);
+    list->count++;
+}
+
+/* The node must be on this list or on none, a detached node leaves the count alone */
+static inline void glthread_list_remove(glthread_list_t *list, glthread_t *glthread)
+{
+    list->count -= (glthread->right != glthread);
+    remove_glthread(glthread);
+}
+
+static inline glthread_t *glthread_list_dequeue_first(glthread_list_t *list)
+{
+    glthread_t *first = dequeue_glthread_first(&list->head);
+
+    list->count -= (first != NULL);
+    return first;
+}
+
+static inline void glthread_list_priority_insert(glthread_list_t *list, glthread_t *glthread,
+                                int (*comp_fn)(void *, void *), int offset)
+{
+    glthread_priority_insert(&list->head, glthread, comp_fn, offset);
+    list->count++;
+}
+
+/* True for an empty list head, and for a node that is on no list */
 #define IS_GLTHREAD_LIST_EMPTY(glthread_ptr)    \
-    (((glthread_ptr)->right == NULL) && ((glthread_ptr)->left == NULL))
+    ((glthread_ptr)->right == (glthread_ptr))
 
 #define GLTHREAD_TO_STRUCT(fn_name, structure_name, field_name)             \
     static inline structure_name *fn_name(glthread_t *glthread_ptr){        \
         return (structure_name *)((char *)(glthread_ptr) - (char *)&(((structure_name *)0)->field_name)); \
-    }   
-    
+    }
+
 #define BASE(glthread_ptr) ((glthread_ptr)->right)
 
+/* The current node may be removed inside the loop */
 #define ITERATE_GLTHREAD_BEGIN(glthread_ptr_start, glthread_ptr)        \
 {                                                                       \
     glthread_t *glthread_tmp = NULL;                                    \
     glthread_ptr = BASE(glthread_ptr_start);                            \
-    for(; glthread_ptr != NULL; glthread_ptr = glthread_tmp){           \
+    for(; glthread_ptr != (glthread_ptr_start); glthread_ptr = glthread_tmp){ \
         glthread_tmp = (glthread_ptr)->right;                           \
 
 #define ITERATE_GLTHREAD_END(glthread_ptr_start, glthread_ptr)          \
@@ -50,4 +148,8 @@ glthread_t *dequeue_glthread_first(glthread_t *base_glthread);
         (void *)((char *)(glthread_ptr) - offset)
 
 
-#endif //GL_THREAD_H
\ No newline at end of file
+#ifdef __cplusplus
+}
+#endif
+
+#endif //GL_THREAD_H
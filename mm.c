@@ -1,25 +1,197 @@
+#define _GNU_SOURCE /* sched_getcpu() */
 #include <stdio.h>
+#include <stdlib.h>
 #include <memory.h>
 #include <unistd.h> /* to get page size using getpagesize()*/
 #include <assert.h>
 #include <sys/mman.h> /* for mmap()*/
+#include <pthread.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sched.h>
+#if __has_include(<sys/rseq.h>)
+#include <sys/rseq.h> /* __rseq_offset and __rseq_size, glibc 2.35 and up */
+#define MM_HAVE_RSEQ
+#endif
 #include "mm.h"
 #include "uapi_mm.h"
+#include "mm_trace.h"
 #include "css.h"
 
+#ifdef MM_QUIET
+/* Built underneath stdio (preload shim) or for timing runs: no tracing.
+ * A function rather than ((void)0) so the arguments still count as used */
+static inline int mm_quiet_printf(const char *fmt, ...){ (void)fmt; return 0; }
+#define printf(...) mm_quiet_printf(__VA_ARGS__)
+#endif
+
+/* xmalloc() payloads are 16 byte aligned as long as every header is a multiple of 16 */
+_Static_assert(offset_of(vm_page_t, page_memory) % MM_MALLOC_ALIGNMENT == 0,
+               "vm page header breaks xmalloc alignment");
+_Static_assert(offset_of(vm_page_t, block_meta_data) % MM_MALLOC_ALIGNMENT == 0,
+               "vm page fields break xmalloc alignment");
+_Static_assert(sizeof(block_meta_data_t) % MM_MALLOC_ALIGNMENT == 0,
+               "block meta data breaks xmalloc alignment");
+_Static_assert(sizeof(block_meta_data_t) == 48, "block tag does not fit the padding");
+_Static_assert(MM_MAX_TAGS <= 65536U, "vm page tag is 16 bits");
+/* even with 64K system pages */
+_Static_assert(MM_MAX_PAGE_SPAN * 65536U / sizeof(block_meta_data_t) < 65536U, "live objects are counted in 16 bits");
+
 static size_t SYSTEM_PAGE_SIZE = 0U;
 static vm_page_for_families_t *first_vm_page_for_families = NULL;
+/* Next unused slot on the head registry page, so registration never scans */
+static vm_page_family_t *mm_next_family_slot = NULL;
+static uint32_t mm_free_family_slots = 0U;
+/* Registered families by name, so neither registration nor xcalloc() by name scans */
+static vm_page_family_t *mm_family_name_hash[MM_FAMILY_NAME_HASH_BUCKETS];
+
+/* Process wide quota, in vm pages. A limit of 0 means unlimited */
+static uint32_t mm_total_page_count = 0U;
+static uint32_t mm_global_soft_page_limit = 0U;
+static uint32_t mm_global_hard_page_limit = 0U;
+static mm_pressure_cb_t mm_global_pressure_cb = NULL;
+static void *mm_global_pressure_ctx = NULL;
+
+static vm_bool_t mm_remote_free_enabled = MM_TRUE;
+static pthread_key_t mm_owner_exit_key;
+static pthread_once_t mm_owner_exit_once = PTHREAD_ONCE_INIT;
+static __thread vm_bool_t mm_owner_exit_armed = MM_FALSE;
+static uint32_t mm_next_family_id = 0U;
+
+/* Background maintenance: owners hand empty pages to the retired list (lock
+ * free, taken whole by the maintenance thread) instead of unmapping them, and
+ * take fresh pages from the prefaulted ready list the thread keeps topped up.
+ */
+static vm_bool_t mm_maintenance_running = MM_FALSE;
+static vm_bool_t mm_maintenance_stopping = MM_FALSE;
+static uint32_t mm_maintenance_period_ms = 0U;
+static pthread_t mm_maintenance_thread;
+static pthread_mutex_t mm_maintenance_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t mm_maintenance_cond = PTHREAD_COND_INITIALIZER;
+static vm_page_t *mm_retired_vm_pages = NULL;
+static uint32_t mm_retired_vm_page_count = 0U;
+static uint32_t mm_retiring_threads = 0U; /* in mm_release_vm_page(), see mm_maintenance_stop() */
+static vm_page_t *mm_ready_vm_pages = NULL;
+static uint32_t mm_ready_vm_page_count = 0U;
+static pthread_mutex_t mm_ready_vm_pages_mutex = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t mm_vm_pages_allocated = 0U;
+static uint64_t mm_single_vm_pages_allocated = 0U; /* the only ones the ready list can serve */
+static uint64_t mm_vm_pages_returned = 0U;
+static mm_stats_t mm_stats_snapshot;
+/* Pass state: the thread and manual mm_maintenance_run_once() calls take
+ * turns under the pass mutex. The single page count is sampled from the first
+ * pass (or mm_maintenance_start()) on, never from the lifetime total */
+static pthread_mutex_t mm_maintenance_pass_mutex = PTHREAD_MUTEX_INITIALIZER;
+static vm_bool_t mm_maintenance_sampled = MM_FALSE;
+static uint64_t mm_maintenance_last_single_vm_pages = 0U;
+static uint64_t mm_maintenance_passes = 0U;
+
+#ifndef MM_NO_TAGS
+/* Shared counters, one cache line per tag: vm pages, and the objects of
+ * threads that have no delta block */
+typedef struct mm_tag_counters_{
+    uint64_t live_bytes;
+    uint64_t live_objects;
+    uint64_t vm_pages;
+}__attribute__((aligned(64))) mm_tag_counters_t;
+
+/* Objects are charged and credited to the calling thread's own block with
+ * plain stores; mm_get_tag_stats() adds up every block. A block outlives its
+ * thread, the sums in it stay part of the totals, and the next thread that
+ * needs a block takes it over */
+typedef struct mm_tag_deltas_{
+    struct mm_tag_deltas_ *next;
+    vm_bool_t in_use;
+    int64_t live_bytes[MM_MAX_TAGS];
+    int64_t live_objects[MM_MAX_TAGS];
+}mm_tag_deltas_t;
+
+static __thread mm_tag_t mm_current_tag = MM_TAG_UNTAGGED;
+static mm_tag_counters_t mm_tag_counters[MM_MAX_TAGS];
+static mm_tag_deltas_t *mm_tag_deltas_list = NULL;
+static pthread_key_t mm_tag_exit_key;
+static pthread_once_t mm_tag_exit_once = PTHREAD_ONCE_INIT;
+static __thread mm_tag_deltas_t *mm_tag_thread_deltas = NULL;
+static __thread vm_bool_t mm_tag_thread_shared = MM_FALSE; /* no block, use the shared counters */
+
+static mm_tag_deltas_t *mm_tag_claim_thread_deltas(void);
+
+static inline void mm_tag_charge(mm_tag_t tag, int64_t bytes, int64_t objects)
+{
+    mm_tag_deltas_t *deltas = mm_tag_thread_deltas;
+
+    if(__builtin_expect(!deltas, MM_FALSE) && !(deltas = mm_tag_claim_thread_deltas())){
+        __atomic_add_fetch(&mm_tag_counters[tag].live_bytes, (uint64_t)bytes, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&mm_tag_counters[tag].live_objects, (uint64_t)objects, __ATOMIC_RELAXED);
+        return;
+    }
+    __atomic_store_n(&deltas->live_bytes[tag], deltas->live_bytes[tag] + bytes, __ATOMIC_RELAXED);
+    __atomic_store_n(&deltas->live_objects[tag], deltas->live_objects[tag] + objects, __ATOMIC_RELAXED);
+}
 
-/* Function to request VM page from kernel */
-static void *mm_get_new_vm_page_from_kernel(int units)
+#define MM_TAG_ALLOC(block_meta_data_ptr)                                                       \
+    do{                                                                                         \
+        (block_meta_data_ptr)->tag = mm_current_tag;                                            \
+        mm_tag_charge(mm_current_tag, (int64_t)(block_meta_data_ptr)->block_size, 1);           \
+    }while(0)
+
+#define MM_TAG_FREE(block_meta_data_ptr) \
+    mm_tag_charge((block_meta_data_ptr)->tag, -(int64_t)(block_meta_data_ptr)->block_size, -1)
+
+#define MM_TAG_PAGE_ALLOC(vm_page_ptr)                                                          \
+    do{                                                                                         \
+        (vm_page_ptr)->tag = (uint16_t)mm_current_tag;                                          \
+        __atomic_add_fetch(&mm_tag_counters[mm_current_tag].vm_pages, (vm_page_ptr)->units, __ATOMIC_RELAXED); \
+    }while(0)
+
+#define MM_TAG_PAGE_FREE(vm_page_ptr) \
+    (__atomic_sub_fetch(&mm_tag_counters[(vm_page_ptr)->tag].vm_pages, (vm_page_ptr)->units, __ATOMIC_RELAXED))
+#else
+#define MM_TAG_ALLOC(block_meta_data_ptr)   ((void)0)
+#define MM_TAG_FREE(block_meta_data_ptr)    ((void)0)
+#define MM_TAG_PAGE_ALLOC(vm_page_ptr)      ((void)0)
+#define MM_TAG_PAGE_FREE(vm_page_ptr)       ((void)0)
+#endif
+
+/* Pressure monitor: cgroup v2 / PSI files read on every poll, and the epoch
+ * owners compare against to notice a trim request */
+static vm_bool_t mm_pressure_monitor_enabled = MM_FALSE;
+static char mm_pressure_cgroup_dir[MM_PRESSURE_PATH_MAX];
+static char mm_pressure_psi_path[MM_PRESSURE_PATH_MAX];
+static uint64_t mm_pressure_last_high_events = UINT64_MAX;
+static uint64_t mm_pressure_last_max_events = UINT64_MAX;
+static mm_pressure_level_t mm_pressure_level = MM_PRESSURE_NONE;
+static mm_pressure_level_t mm_trim_level = MM_PRESSURE_NONE;
+static uint32_t mm_trim_epoch = 0U;
+static mm_shrink_cb_t mm_shrink_cbs[MM_MAX_SHRINK_CALLBACKS];
+static void *mm_shrink_ctxs[MM_MAX_SHRINK_CALLBACKS];
+static uint32_t mm_shrink_cb_count = 0U;
+static pthread_mutex_t mm_pressure_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+/* Out-of-band families: reserved (PROT_NONE, no swap reservation) data range
+ * and its dense metadata table, only the pages in use are ever backed */
+static char *mm_oob_arena = NULL;
+static mm_oob_page_meta_t *mm_oob_page_meta = NULL;
+static uint32_t mm_oob_next_page = 0U;
+static uint32_t mm_oob_free_page = MM_OOB_NO_PAGE;
+static pthread_mutex_t mm_oob_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+#define MM_OOB_ARENA_SIZE ((size_t)MM_OOB_ARENA_PAGES * SYSTEM_PAGE_SIZE)
+
+/* xmalloc() size classes, families are registered on first use */
+static vm_page_family_t *mm_size_class_families[MM_SIZE_CLASS_COUNT];
+
+/* Function to request VM page from kernel. Anonymous memory comes zeroed and
+ * is faulted in on first touch, or right here (MAP_POPULATE) when populate is
+ * set: mm_reserve() asks for that, nothing else does */
+static void *mm_get_new_vm_page_from_kernel(int units, vm_bool_t populate)
 {
     char *vm_page = mmap(0, units * SYSTEM_PAGE_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC,
-                            MAP_ANON | MAP_PRIVATE, 0, 0);
+                            MAP_ANON | MAP_PRIVATE | (populate ? MAP_POPULATE : 0), 0, 0);
     if(vm_page == MAP_FAILED){
         printf("Error: VM Page allocation failed\n");
         return NULL;
     }
-    memset(vm_page, 0, units * SYSTEM_PAGE_SIZE);
     return (void *)vm_page;
 }
 
@@ -31,13 +203,29 @@ static void mm_return_vm_page_to_kernel(void *vm_page, int units)
     }
 }
 
+/* Scratch space for the walkers, and tag delta blocks: neither prefaulted
+ * nor executable, given back with mm_return_vm_page_to_kernel() */
+static void *mm_get_scratch_vm_pages(int units)
+{
+    void *scratch = mmap(0, units * SYSTEM_PAGE_SIZE, PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, 0, 0);
+
+    if(scratch == MAP_FAILED){
+        printf("Error: %s() - scratch allocation failed\n", __FUNCTION__);
+        return NULL;
+    }
+    return scratch;
+}
+
 static void mm_union_free_blocks(block_meta_data_t *first, block_meta_data_t *second)
 {
+    vm_page_t *vm_page = MM_GET_PAGE_FROM_META_BLOCK(first);
+    glthread_list_t *free_list = &vm_page->page_family->free_block_priority_list_head;
+
     assert(first->is_free == MM_TRUE && second->is_free == MM_TRUE);
     first->block_size += (sizeof(block_meta_data_t) + second->block_size);
     printf("%s(): block meta data @ %p of size %u\n", __FUNCTION__, first, first->block_size);
-    remove_glthread(&first->priority_list_glue);
-    remove_glthread(&second->priority_list_glue);
+    glthread_list_remove(free_list, &first->priority_list_glue);
+    glthread_list_remove(free_list, &second->priority_list_glue);
     first->next_block = second->next_block;
     if(first->next_block)
         first->next_block->prev_block = first;
@@ -75,7 +263,7 @@ static void mm_add_free_block_meta_data_to_free_block_list(vm_page_family_t *vm_
     block_meta_data_t *free_block){
 
     assert(free_block->is_free == MM_TRUE);
-    glthread_priority_insert(&vm_page_family->free_block_priority_list_head,
+    glthread_list_priority_insert(&vm_page_family->free_block_priority_list_head,
                             &free_block->priority_list_glue,
                             free_blocks_comparison_function,
                             offset_of(block_meta_data_t, priority_list_glue));
@@ -85,8 +273,8 @@ static void mm_add_free_block_meta_data_to_free_block_list(vm_page_family_t *vm_
 /* get the first element in the priority queue */
 static inline block_meta_data_t *mm_get_biggest_free_block_page_family(vm_page_family_t *vm_page_family)
 {
-    glthread_t *biggest_free_block_glue =  vm_page_family->free_block_priority_list_head.right;
-    if(biggest_free_block_glue){
+    glthread_t *biggest_free_block_glue =  vm_page_family->free_block_priority_list_head.head.right;
+    if(biggest_free_block_glue != &vm_page_family->free_block_priority_list_head.head){
         //printf("%s(): biggest free block in priority queue is @ %p\n", )
         return glue_to_block_metadata(biggest_free_block_glue);
     }
@@ -116,7 +304,7 @@ static vm_bool_t mm_split_free_data_block_for_allocation(vm_page_family_t *vm_pa
     block_meta_data->block_size = size;
     printf("%s(): block meta data @ %p of size %u\n", __FUNCTION__, block_meta_data, block_meta_data->block_size);
     
-    remove_glthread(&block_meta_data->priority_list_glue);
+    glthread_list_remove(&vm_page_family->free_block_priority_list_head, &block_meta_data->priority_list_glue);
     /*block_meta_data->offset unchanged */
 
     /* Case #1: No split */
@@ -160,16 +348,111 @@ static vm_bool_t mm_split_free_data_block_for_allocation(vm_page_family_t *vm_pa
     return MM_TRUE;
 }
 
+static inline uint32_t mm_bytes_to_vm_pages(uint64_t bytes)
+{
+    /* limits may be set before anything else touched the manager */
+    if(!SYSTEM_PAGE_SIZE)
+        mm_init();
+    return (uint32_t)((bytes + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE);
+}
+
+/* Limits are only ever checked when a family needs one more vm page, against
+ * page counts maintained on page creation and deletion, so they are O(1) and
+ * never show up on the block allocation fast path.
+ */
+static vm_bool_t mm_page_family_at_soft_limit(vm_page_family_t *vm_page_family)
+{
+    /* mm_shard_allocate() asks for the parent, outside the shard lock */
+    if(vm_page_family->shard_parent)
+        return MM_FALSE;
+    if(vm_page_family->soft_page_limit &&
+        __atomic_load_n(&vm_page_family->page_count, __ATOMIC_RELAXED) * vm_page_family->page_span >=
+            vm_page_family->soft_page_limit)
+        return MM_TRUE;
+    if(mm_global_soft_page_limit &&
+        __atomic_load_n(&mm_total_page_count, __ATOMIC_RELAXED) >= mm_global_soft_page_limit)
+        return MM_TRUE;
+    return MM_FALSE;
+}
+
+static vm_bool_t mm_page_family_at_hard_limit(vm_page_family_t *vm_page_family)
+{
+    if(vm_page_family->hard_page_limit &&
+        (vm_page_family->page_count + 1U) * vm_page_family->page_span > vm_page_family->hard_page_limit)
+        return MM_TRUE;
+    return MM_FALSE;
+}
+
+/* The limits of a sharded family are set on the parent, whose page_count is
+ * the sum over its shards. Shards grow side by side under their own locks, so
+ * the parent is checked and counted in one step, as mm_global_reserve_pages()
+ * does for the global limit */
+static vm_bool_t mm_shard_parent_reserve_page(vm_page_family_t *shard)
+{
+    vm_page_family_t *parent = shard->shard_parent;
+    uint32_t count = __atomic_load_n(&parent->page_count, __ATOMIC_RELAXED);
+
+    do{
+        if(parent->hard_page_limit && (count + 1U) * shard->page_span > parent->hard_page_limit)
+            return MM_FALSE;
+    }while(!__atomic_compare_exchange_n(&parent->page_count, &count, count + 1U,
+                                        MM_TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return MM_TRUE;
+}
+
+static inline void mm_shard_parent_unreserve_page(vm_page_family_t *shard)
+{
+    __atomic_sub_fetch(&shard->shard_parent->page_count, 1U, __ATOMIC_RELAXED);
+}
+
+/* Check and count in one step, so families growing on different threads can
+ * not all pass the check and overshoot the hard limit together. Give the
+ * pages back with mm_global_unreserve_pages() if the mmap() then fails */
+static vm_bool_t mm_global_reserve_pages(uint32_t units)
+{
+    uint32_t total = __atomic_load_n(&mm_total_page_count, __ATOMIC_RELAXED);
+
+    do{
+        if(mm_global_hard_page_limit && total + units > mm_global_hard_page_limit)
+            return MM_FALSE;
+    }while(!__atomic_compare_exchange_n(&mm_total_page_count, &total, total + units,
+                                        MM_TRUE, __ATOMIC_RELAXED, __ATOMIC_RELAXED));
+    return MM_TRUE;
+}
+
+static inline void mm_global_unreserve_pages(uint32_t units)
+{
+    __atomic_sub_fetch(&mm_total_page_count, units, __ATOMIC_RELAXED);
+}
+
+static void mm_invoke_pressure_callbacks(vm_page_family_t *vm_page_family)
+{
+    if(vm_page_family->pressure_cb)
+        vm_page_family->pressure_cb(vm_page_family, vm_page_family->pressure_ctx);
+    if(mm_global_pressure_cb)
+        mm_global_pressure_cb(vm_page_family, mm_global_pressure_ctx);
+}
+
 static block_meta_data_t *mm_allocate_free_data_block(vm_page_family_t *vm_page_family, uint32_t req_size)
 {
     vm_bool_t status = MM_FALSE;
     vm_page_t *vm_page = NULL;
     block_meta_data_t *biggest_block_meta_data =  mm_get_biggest_free_block_page_family(vm_page_family);
 
+    if((!biggest_block_meta_data || biggest_block_meta_data->block_size < req_size) &&
+        mm_page_family_at_soft_limit(vm_page_family)){
+
+        /* let the application release objects before we grow past the soft limit */
+        mm_invoke_pressure_callbacks(vm_page_family);
+        biggest_block_meta_data = mm_get_biggest_free_block_page_family(vm_page_family);
+    }
+
     if(!biggest_block_meta_data || biggest_block_meta_data->block_size < req_size){
         
         /* time to add a new page to meet the request */
         vm_page = mm_family_new_page_add(vm_page_family);
+        if(!vm_page)
+            return NULL;
         printf("%s() - INFO: vm page created %p\n", __FUNCTION__, vm_page);
         printf("%s() - INFO: biggest data block found @ %p, met block size is %u and requested size is %u\n", 
             __FUNCTION__,
@@ -195,87 +478,249 @@ static block_meta_data_t *mm_allocate_free_data_block(vm_page_family_t *vm_page_
     return NULL;
 }
 
+/* Objects a vm page of span units holds when allocated one at a time, each
+ * behind its own meta block (the first one lives in the vm page header) */
+static inline uint32_t mm_page_span_objects(uint32_t struct_size, uint32_t units)
+{
+    return (uint32_t)((units * SYSTEM_PAGE_SIZE - offset_of(vm_page_t, page_memory) + sizeof(block_meta_data_t)) /
+                      (struct_size + sizeof(block_meta_data_t)));
+}
+
+/* Bytes of a span no object can use: its header plus the tail too short for
+ * one more object. The meta block in front of every object is not counted,
+ * no span size gets rid of it */
+static inline uint32_t mm_page_span_waste(uint32_t struct_size, uint32_t units)
+{
+    return (uint32_t)(units * SYSTEM_PAGE_SIZE) -
+           mm_page_span_objects(struct_size, units) * struct_size -
+           (mm_page_span_objects(struct_size, units) - 1U) * sizeof(block_meta_data_t);
+}
+
+/* Span wasting the smallest fraction of itself. The header is paid once per
+ * vm page, so that fraction keeps shrinking with the span: spans within
+ * 1/MM_PAGE_SPAN_TIE_DIVISOR of the best count as a tie and the smallest of
+ * them wins */
+static uint32_t mm_choose_page_span(uint32_t struct_size)
+{
+    uint32_t best_units = 0U;
+    uint32_t units = 1U;
+    uint64_t waste = 0U;
+    uint64_t best_waste = 0U;
+
+    for(units = 1U; units <= MM_MAX_PAGE_SPAN; units++){
+        if(mm_page_span_objects(struct_size, units) == 0U)
+            continue;
+        waste = mm_page_span_waste(struct_size, units);
+        /* compare waste / units across spans without dividing */
+        if(!best_units || waste * best_units < best_waste * units){
+            best_waste = waste;
+            best_units = units;
+        }
+    }
+    for(units = 1U; units < best_units; units++){
+        if(mm_page_span_objects(struct_size, units) == 0U)
+            continue;
+        waste = mm_page_span_waste(struct_size, units);
+        /* waste / units <= best_waste / best_units + SYSTEM_PAGE_SIZE / MM_PAGE_SPAN_TIE_DIVISOR */
+        if(waste * best_units * MM_PAGE_SPAN_TIE_DIVISOR <=
+           best_waste * units * MM_PAGE_SPAN_TIE_DIVISOR + (uint64_t)units * best_units * SYSTEM_PAGE_SIZE)
+            return units;
+    }
+    return best_units;
+}
+
+/* FNV-1a over the part of the name strncmp() compares in a lookup */
+static inline uint32_t mm_family_name_hash_bucket(const char *struct_name)
+{
+    uint32_t hash = 2166136261U;
+    uint32_t i = 0U;
+
+    for(i = 0U; i < MM_MAX_STRUCT_NAME && struct_name[i]; i++){
+        hash ^= (uint8_t)struct_name[i];
+        hash *= 16777619U;
+    }
+    return hash & (MM_FAMILY_NAME_HASH_BUCKETS - 1U);
+}
+
+static void mm_init_page_family(vm_page_family_t *vm_page_family, char *struct_name, uint32_t struct_size)
+{
+    uint32_t bucket = mm_family_name_hash_bucket(struct_name);
+
+    pthread_mutexattr_t family_lock_attr;
+
+    /* spins a little before sleeping: cheap when uncontended, and a holder
+     * preempted inside the lock does not cost the waiters their time slices */
+    pthread_mutexattr_init(&family_lock_attr);
+    pthread_mutexattr_settype(&family_lock_attr, PTHREAD_MUTEX_ADAPTIVE_NP);
+    pthread_mutex_init(&vm_page_family->family_lock, &family_lock_attr);
+    pthread_mutexattr_destroy(&family_lock_attr);
+    /* a full MM_MAX_STRUCT_NAME name is kept unterminated, lookups use strncmp() */
+    memset(vm_page_family->struct_name, 0, MM_MAX_STRUCT_NAME);
+    memcpy(vm_page_family->struct_name, struct_name, strnlen(struct_name, MM_MAX_STRUCT_NAME));
+    vm_page_family->first_page = NULL;
+    init_glthread_list(&vm_page_family->free_block_priority_list_head);
+    vm_page_family->owner_bound = MM_FALSE;
+    vm_page_family->orphaned = MM_FALSE;
+    vm_page_family->remote_free_head = NULL;
+    vm_page_family->page_count = 0U;
+    vm_page_family->soft_page_limit = 0U;
+    vm_page_family->hard_page_limit = 0U;
+    vm_page_family->pressure_cb = NULL;
+    vm_page_family->pressure_ctx = NULL;
+    vm_page_family->family_type = MM_PAGE_FAMILY_GENERAL;
+    vm_page_family->region_cursor = NULL;
+    vm_page_family->region_end = NULL;
+    vm_page_family->region_last_block = NULL;
+    vm_page_family->region_tail_page = NULL;
+    vm_page_family->region_free_pages = NULL;
+    vm_page_family->region_free_page_count = 0U;
+    vm_page_family->region_warm_pages = 0U;
+    vm_page_family->reserved_page_count = 0U;
+    vm_page_family->page_span = mm_choose_page_span(struct_size);
+    vm_page_family->object_ctor = NULL;
+    vm_page_family->object_dtor = NULL;
+    vm_page_family->cache_spare_page = NULL;
+    vm_page_family->oob_slot_size = 0U;
+    vm_page_family->oob_first_partial = MM_OOB_NO_PAGE;
+    vm_page_family->oob_remote_free_head = NULL;
+    vm_page_family->trim_epoch = __atomic_load_n(&mm_trim_epoch, __ATOMIC_RELAXED);
+    vm_page_family->family_id = mm_next_family_id++;
+    vm_page_family->trace_session = 0U;
+    vm_page_family->shards = NULL;
+    vm_page_family->shard_count = 0U;
+    vm_page_family->shard_parent = NULL;
+    /* a non zero size makes the slot visible to registry walkers on other
+     * threads (mm_pressure_poll(), exiting owners) */
+    __atomic_store_n(&vm_page_family->struct_size, struct_size, __ATOMIC_RELEASE);
+    vm_page_family->name_hash_next = mm_family_name_hash[bucket];
+    __atomic_store_n(&mm_family_name_hash[bucket], vm_page_family, __ATOMIC_RELEASE);
+}
+
+/* The calling thread owns the family: bound to it, and not left behind by an
+ * owner that unbound or exited. owner_thread is published before the flags */
+static inline vm_bool_t mm_page_family_is_owner(vm_page_family_t *vm_page_family)
+{
+    return __atomic_load_n(&vm_page_family->owner_bound, __ATOMIC_ACQUIRE) &&
+           !__atomic_load_n(&vm_page_family->orphaned, __ATOMIC_ACQUIRE) &&
+           pthread_equal(__atomic_load_n(&vm_page_family->owner_thread, __ATOMIC_RELAXED), pthread_self());
+}
+
+/* Frees from the calling thread have to go through the remote free stack */
+static inline vm_bool_t mm_is_remote_free(vm_page_family_t *vm_page_family)
+{
+    return mm_remote_free_enabled && __atomic_load_n(&vm_page_family->owner_bound, __ATOMIC_ACQUIRE) &&
+           !mm_page_family_is_owner(vm_page_family);
+}
+
+/* Blocks freed by a thread other than the family owner are parked on a lock free
+ * MPSC stack, linked through their (unused while allocated) priority list glue.
+ * Only the owner pops, and it always takes the whole stack, so there is no ABA.
+ * They are marked MM_FREE_PENDING so walkers skip them until then.
+ */
+static void mm_remote_free_push(vm_page_family_t *vm_page_family, block_meta_data_t *block_meta_data)
+{
+    block_meta_data_t *head = __atomic_load_n(&vm_page_family->remote_free_head, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&block_meta_data->is_free, MM_FREE_PENDING, __ATOMIC_RELAXED);
+    do{
+        block_meta_data->priority_list_glue.right = head ? &head->priority_list_glue : NULL;
+    }while(!__atomic_compare_exchange_n(&vm_page_family->remote_free_head, &head, block_meta_data,
+                                        MM_TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
 /* Global Function definitions */
 void mm_init(void)
 {
+    if(SYSTEM_PAGE_SIZE)
+        return;
     SYSTEM_PAGE_SIZE = getpagesize();
     printf("%s(): Page size is %u\n", __FUNCTION__, SYSTEM_PAGE_SIZE);
 }
 
-void mm_instantiate_new_page_family(char *struct_name, uint32_t struct_size)
+/* Hand out the next registry slot, chaining a new registry page in front once
+ * the head page is full */
+static vm_page_family_t *mm_new_page_family_slot(void)
 {
-    vm_page_family_t *vm_page_family_curr = NULL;
     vm_page_for_families_t *new_vm_page_for_families = NULL;
-    uint32_t count = 0U;
-
-    if(struct_size > SYSTEM_USABLE_PAGE_SIZE){
-        printf("Error: %s() - Size of structure %s exceeds system page size\n", __FUNCTION__, struct_name);
-        return;
-    }
 
-    /* First time creation of new page family */
-    if(!first_vm_page_for_families){
-        first_vm_page_for_families = (vm_page_for_families_t *)mm_get_new_vm_page_from_kernel(1);
-        first_vm_page_for_families->next = NULL;
-        strncpy(first_vm_page_for_families->vm_page_family[0].struct_name, struct_name, MM_MAX_STRUCT_NAME);
-        first_vm_page_for_families->vm_page_family[0].struct_size = struct_size;
-        first_vm_page_for_families->vm_page_family[0].first_page = NULL;
-        init_glthread(&first_vm_page_for_families->vm_page_family[0].free_block_priority_list_head);
-        return;
+    if(!mm_free_family_slots){
+        new_vm_page_for_families = (vm_page_for_families_t *)mm_get_new_vm_page_from_kernel(1, MM_FALSE);
+        if(!new_vm_page_for_families)
+            return NULL;
+        new_vm_page_for_families->next = first_vm_page_for_families;
+        first_vm_page_for_families = new_vm_page_for_families;
+        mm_next_family_slot = &new_vm_page_for_families->vm_page_family[0];
+        mm_free_family_slots = MAX_FAMILIES_PER_VM_PAGE;
     }
+    mm_free_family_slots--;
+    return mm_next_family_slot++;
+}
 
-    vm_page_family_curr = mm_lookup_page_family_by_name(struct_name);
-    if(vm_page_family_curr)
-        assert(0);
+vm_page_family_t *mm_instantiate_new_page_family(char *struct_name, uint32_t struct_size)
+{
+    vm_page_family_t *vm_page_family_curr = NULL;
 
-    /* Iterate over the family page and look if space is available */
-    ITERATE_PAGE_FAMILIES_BEGIN(first_vm_page_for_families, vm_page_family_curr){
-            
-        count++;
+    /* a structure bigger than a system page gets a multi page span */
+    if(!SYSTEM_PAGE_SIZE)
+        mm_init();
+    if(!mm_page_span_objects(struct_size, MM_MAX_PAGE_SPAN)){
+        printf("Error: %s() - Size of structure %s exceeds the biggest vm page span\n", __FUNCTION__, struct_name);
+        return NULL;
+    }
 
-    }ITERATE_PAGE_FAMILIES_END(first_vm_page_for_families, vm_page_family_curr);
+    if(first_vm_page_for_families){
+        vm_page_family_curr = mm_lookup_page_family_by_name(struct_name);
+        if(vm_page_family_curr)
+            assert(0);
+    }
 
-    /* If no space is available, create a new vm page family */
-    if(count == MAX_FAMILIES_PER_VM_PAGE){
+    vm_page_family_curr = mm_new_page_family_slot();
+    if(!vm_page_family_curr)
+        return NULL;
+    mm_init_page_family(vm_page_family_curr, struct_name, struct_size);
+    return vm_page_family_curr;
+}
 
-        new_vm_page_for_families = (vm_page_for_families_t *)mm_get_new_vm_page_from_kernel(1);
-        new_vm_page_for_families->next = first_vm_page_for_families;
-        first_vm_page_for_families = new_vm_page_for_families;
+/* Whole registration table in one go, typically from a constructor. Each
+ * entry may ask for a reservation and a place to store its family */
+uint32_t mm_register_page_families(const mm_page_family_reg_t *table, uint32_t count)
+{
+    vm_page_family_t *vm_page_family = NULL;
+    uint32_t registered = 0U;
+    uint32_t i = 0U;
+
+    mm_init();
+    for(i = 0U; i < count; i++){
+        vm_page_family = mm_instantiate_new_page_family(table[i].struct_name, table[i].struct_size);
+        if(table[i].page_family)
+            *table[i].page_family = vm_page_family;
+        if(!vm_page_family)
+            continue;
+        if(table[i].reserve_objects)
+            mm_reserve(vm_page_family, table[i].reserve_objects);
+        registered++;
     }
-    /* Now a vm page family pointer would be available either from the old page family or a new page family */
-    /* copy the entries to it */
-    strncpy(vm_page_family_curr->struct_name, struct_name, MM_MAX_STRUCT_NAME);
-    vm_page_family_curr->struct_size = struct_size;
-    vm_page_family_curr->first_page = NULL;
-    init_glthread(&vm_page_family_curr->free_block_priority_list_head);
+    return registered;
 }
 
 vm_page_family_t *mm_lookup_page_family_by_name(char *struct_name)
 {
-    uint32_t count = 0U;
     vm_page_family_t *vm_page_family_curr = NULL;
-    vm_page_for_families_t *curr_vm_page_for_families = NULL;
 
     if(!first_vm_page_for_families){
         printf("Error: No Page family exists\n");
         return NULL;
     }
 
-    for(curr_vm_page_for_families = first_vm_page_for_families; curr_vm_page_for_families; 
-        curr_vm_page_for_families = curr_vm_page_for_families->next)
+    for(vm_page_family_curr = __atomic_load_n(&mm_family_name_hash[mm_family_name_hash_bucket(struct_name)],
+                                              __ATOMIC_ACQUIRE);
+        vm_page_family_curr; vm_page_family_curr = vm_page_family_curr->name_hash_next)
     {
-        ITERATE_PAGE_FAMILIES_BEGIN(curr_vm_page_for_families, vm_page_family_curr)
+        if (strncmp(vm_page_family_curr->struct_name, struct_name, MM_MAX_STRUCT_NAME) == 0U)
         {
-            if (vm_page_family_curr->struct_size > 0U)
-            {
-                if (strncmp(vm_page_family_curr->struct_name, struct_name, MM_MAX_STRUCT_NAME) == 0U)
-                {
-                    printf("%s(): page_family found @ %p\n",__FUNCTION__, vm_page_family_curr);
-                    return vm_page_family_curr;
-                }
-            }
+            printf("%s(): page_family found @ %p\n",__FUNCTION__, vm_page_family_curr);
+            return vm_page_family_curr;
         }
-        ITERATE_PAGE_FAMILIES_END(curr_vm_page_for_families, vm_page_family_curr);
     }
     return NULL;
 }
@@ -328,22 +773,151 @@ vm_bool_t mm_is_vm_page_empty(vm_page_t *vm_page)
     return MM_FALSE;
 }
 
-vm_page_t *mm_allocate_vm_page(vm_page_family_t *vm_page_family)
+static vm_page_t *mm_take_ready_vm_page(void)
+{
+    vm_page_t *vm_page = NULL;
+
+    if(!__atomic_load_n(&mm_ready_vm_page_count, __ATOMIC_RELAXED))
+        return NULL;
+    pthread_mutex_lock(&mm_ready_vm_pages_mutex);
+    vm_page = mm_ready_vm_pages;
+    if(vm_page){
+        mm_ready_vm_pages = vm_page->next;
+        __atomic_sub_fetch(&mm_ready_vm_page_count, 1U, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&mm_ready_vm_pages_mutex);
+    return vm_page;
+}
+
+static void mm_put_ready_vm_page(vm_page_t *vm_page)
+{
+    pthread_mutex_lock(&mm_ready_vm_pages_mutex);
+    vm_page->next = mm_ready_vm_pages;
+    mm_ready_vm_pages = vm_page;
+    __atomic_add_fetch(&mm_ready_vm_page_count, 1U, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&mm_ready_vm_pages_mutex);
+}
+
+/* A zeroed vm page of the given span: single pages come prefaulted from the
+ * maintenance thread if one is ready, everything else straight from the
+ * kernel, populated only when asked to */
+static vm_page_t *mm_acquire_vm_page(uint32_t units, vm_bool_t populate)
+{
+    vm_page_t *vm_page = units == 1U ? mm_take_ready_vm_page() : NULL;
+
+    if(!vm_page){
+        if(!mm_global_reserve_pages(units))
+            return NULL;
+        vm_page = (vm_page_t *)mm_get_new_vm_page_from_kernel(units, populate);
+        if(!vm_page){
+            mm_global_unreserve_pages(units);
+            return NULL;
+        }
+    }
+    __atomic_add_fetch(&mm_vm_pages_allocated, units, __ATOMIC_RELAXED);
+    if(units == 1U)
+        __atomic_add_fetch(&mm_single_vm_pages_allocated, 1U, __ATOMIC_RELAXED);
+    return vm_page;
+}
+
+static void mm_unmap_vm_page(vm_page_t *vm_page)
+{
+    uint32_t units = vm_page->units;
+
+    __atomic_sub_fetch(&mm_total_page_count, units, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mm_vm_pages_returned, units, __ATOMIC_RELAXED);
+    mm_return_vm_page_to_kernel((void *)vm_page, units);
+}
+
+/* With the maintenance thread running the munmap() leaves the caller's path */
+static void mm_release_vm_page(vm_page_t *vm_page)
+{
+    vm_page_t *head = NULL;
+
+    MM_TAG_PAGE_FREE(vm_page);
+    /* announce ourselves before looking at the flag: mm_maintenance_stop()
+     * clears the flag and then waits for us before its final flush */
+    __atomic_add_fetch(&mm_retiring_threads, 1U, __ATOMIC_SEQ_CST);
+    if(!__atomic_load_n(&mm_maintenance_running, __ATOMIC_SEQ_CST)){
+        __atomic_sub_fetch(&mm_retiring_threads, 1U, __ATOMIC_RELEASE);
+        mm_unmap_vm_page(vm_page);
+        return;
+    }
+    head = __atomic_load_n(&mm_retired_vm_pages, __ATOMIC_RELAXED);
+    do{
+        vm_page->next = head;
+    }while(!__atomic_compare_exchange_n(&mm_retired_vm_pages, &head, vm_page,
+                                        MM_TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    __atomic_add_fetch(&mm_retired_vm_page_count, 1U, __ATOMIC_RELAXED);
+    __atomic_sub_fetch(&mm_retiring_threads, 1U, __ATOMIC_RELEASE);
+}
+
+/* Object cache families: a new vm page is cut into fixed slots, each one
+ * constructed once. Free slots sit on the family list in constructed state,
+ * pushed at the head so the most recently freed (cache hot) one goes first.
+ */
+static void mm_cache_populate_vm_page(vm_page_family_t *vm_page_family, vm_page_t *vm_page)
+{
+    uint32_t slot_size = vm_page_family->struct_size;
+    char *end_address_of_vm_page = (char *)vm_page + vm_page->units * SYSTEM_PAGE_SIZE;
+    block_meta_data_t *prev_block = NULL;
+    block_meta_data_t *curr = &vm_page->block_meta_data;
+
+    while((char *)(curr + 1) + slot_size <= end_address_of_vm_page){
+        curr->is_free = MM_TRUE;
+        curr->block_size = slot_size;
+        curr->offset = (uint32_t)((char *)curr - (char *)vm_page);
+        curr->prev_block = prev_block;
+        curr->next_block = NULL;
+        if(prev_block)
+            prev_block->next_block = curr;
+        init_glthread(&curr->priority_list_glue);
+        if(vm_page_family->object_ctor)
+            vm_page_family->object_ctor(curr + 1);
+        glthread_list_add_first(&vm_page_family->free_block_priority_list_head, &curr->priority_list_glue);
+        prev_block = curr;
+        curr = (block_meta_data_t *)((char *)(curr + 1) + slot_size);
+    }
+    vm_page->live_objects = 0U;
+}
+
+static vm_page_t *mm_allocate_vm_page_populate(vm_page_family_t *vm_page_family, vm_bool_t populate)
 {
     vm_page_t *prev_first_page = NULL;
-    vm_page_t *vm_page = (vm_page_t *)mm_get_new_vm_page_from_kernel(1);
+    vm_page_t *vm_page = NULL;
+
+    if(mm_page_family_at_hard_limit(vm_page_family) ||
+        (vm_page_family->shard_parent && !mm_shard_parent_reserve_page(vm_page_family))){
+        printf("Error: %s() - page family %s reached its memory limit\n", __FUNCTION__, vm_page_family->struct_name);
+        return NULL;
+    }
+    vm_page = mm_acquire_vm_page(vm_page_family->page_span, populate);
+    if(!vm_page){
+        if(vm_page_family->shard_parent)
+            mm_shard_parent_unreserve_page(vm_page_family);
+        printf("Error: %s() - no vm page for page family %s\n", __FUNCTION__, vm_page_family->struct_name);
+        return NULL;
+    }
+    vm_page_family->page_count++;
     printf("%s(): vm page created @ %p\n", __FUNCTION__, vm_page);
 
     MARK_VM_PAGE_EMPTY(vm_page);
-    vm_page->block_meta_data.block_size = mm_max_page_allocatable_memory(1);
+    vm_page->block_meta_data.block_size = mm_max_page_allocatable_memory(vm_page_family->page_span);
     printf("%s(): block meta data @ %p of size %d\n", __FUNCTION__, &vm_page->block_meta_data, vm_page->block_meta_data.block_size);
     vm_page->block_meta_data.offset = offset_of(vm_page_t, block_meta_data);
 
     vm_page->next = NULL;
     vm_page->prev = NULL;
     vm_page->page_family = vm_page_family;
+    vm_page->units = vm_page_family->page_span;
+    vm_page->live_objects = 0U;
+    MM_TAG_PAGE_ALLOC(vm_page);
     init_glthread(&vm_page->block_meta_data.priority_list_glue);
-    mm_add_free_block_meta_data_to_free_block_list(vm_page_family, &vm_page->block_meta_data);
+    /* region pages are bump allocated, they never go through the free block list */
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_OBJECT_CACHE)
+        mm_cache_populate_vm_page(vm_page_family, vm_page);
+    else if(vm_page_family->family_type != MM_PAGE_FAMILY_REGION)
+        mm_add_free_block_meta_data_to_free_block_list(vm_page_family, &vm_page->block_meta_data);
 
     /*Set the back pointer to page family*/
     vm_page->page_family = vm_page_family;
@@ -360,10 +934,19 @@ vm_page_t *mm_allocate_vm_page(vm_page_family_t *vm_page_family)
     return vm_page;
 }
 
+vm_page_t *mm_allocate_vm_page(vm_page_family_t *vm_page_family)
+{
+    return mm_allocate_vm_page_populate(vm_page_family, MM_FALSE);
+}
+
 void mm_vm_page_delete_and_free(vm_page_t *vm_page)
 {
     vm_page_family_t *vm_page_family = vm_page->page_family;
 
+    vm_page_family->page_count--;
+    if(vm_page_family->shard_parent)
+        mm_shard_parent_unreserve_page(vm_page_family);
+
     if(vm_page_family->first_page == vm_page){
 
         vm_page_family->first_page = vm_page->next;
@@ -372,7 +955,7 @@ void mm_vm_page_delete_and_free(vm_page_t *vm_page)
         vm_page->next = NULL;
         vm_page->prev = NULL;
         vm_page->page_family = NULL;
-        mm_return_vm_page_to_kernel((void *)vm_page, 1);
+        mm_release_vm_page(vm_page);
         return;
     }
     
@@ -381,7 +964,12 @@ void mm_vm_page_delete_and_free(vm_page_t *vm_page)
     if(vm_page->prev)
         vm_page->prev->next = vm_page->next;
 
-    mm_return_vm_page_to_kernel((void *)vm_page, 1);
+    mm_release_vm_page(vm_page);
+}
+
+uint32_t mm_page_family_max_units(vm_page_family_t *page_family)
+{
+    return mm_max_page_allocatable_memory(page_family->page_span) / page_family->struct_size;
 }
 
 void *xcalloc(char *struct_name, int units)
@@ -392,108 +980,2167 @@ void *xcalloc(char *struct_name, int units)
         printf("Error: Structure %s is not registered with memory manager\n", struct_name);
         return NULL;
     }
+    return xcalloc_page_family(page_family, units);
+}
 
-    /* check if the requested memory fits with-in a vm page */
-    if((page_family->struct_size * units) > mm_max_page_allocatable_memory(1)){
-        printf("Error: Memory requested exceeds page size\n");
-        return NULL;
-    }
+/* Nearest free block to the hint, walking outwards from it along its own page */
+static block_meta_data_t *mm_find_free_block_near(block_meta_data_t *hint_block, uint32_t req_size)
+{
+    block_meta_data_t *curr = NULL;
 
-    /* find a data block which can satisfy the request */
-    block_meta_data_t *free_block_meta_data = mm_allocate_free_data_block(page_family, (units * page_family->struct_size));
-    if(free_block_meta_data){
-        memset((char *)(free_block_meta_data + 1), 0, free_block_meta_data->block_size);
-        return (void *)(free_block_meta_data + 1);
+    for(curr = NEXT_META_BLOCK(hint_block); curr; curr = NEXT_META_BLOCK(curr)){
+        if(curr->is_free == MM_TRUE && curr->block_size >= req_size)
+            return curr;
+    }
+    for(curr = PREV_META_BLOCK(hint_block); curr; curr = PREV_META_BLOCK(curr)){
+        if(curr->is_free == MM_TRUE && curr->block_size >= req_size)
+            return curr;
     }
-    mm_print_vm_page_priority_queue(page_family);
     return NULL;
 }
 
-static int mm_get_hard_internal_memory_frag_size(block_meta_data_t *first, block_meta_data_t *second)
+static block_meta_data_t *mm_find_free_block_on_vm_page(vm_page_t *vm_page, uint32_t req_size)
 {
-    //assert(first || second);
-    /* confirm the existance of a hard fragmented memory between first and second arguments */
-    //assert(first->is_free == MM_TRUE || second->is_free == MM_TRUE);
+    block_meta_data_t *curr = NULL;
 
-    block_meta_data_t *next_block = NEXT_META_BLOCK_BY_SIZE(first);
-    return (int)(second - next_block);
+    if(!vm_page)
+        return NULL;
+    ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page, curr){
+        if(curr->is_free == MM_TRUE && curr->block_size >= req_size)
+            return curr;
+    }ITERATE_VM_PAGE_ALL_BLOCKS_END(vm_page, curr);
+    return NULL;
 }
 
-static block_meta_data_t *mm_free_blocks(block_meta_data_t *to_be_free_block){
+static inline vm_bool_t mm_is_oob_ptr(void *ptr);
 
-    block_meta_data_t *returning_block = NULL;
-    block_meta_data_t *next_block = NULL;
-    block_meta_data_t *prev_block = NULL;
-    assert(to_be_free_block->is_free == MM_FALSE);
+/* Locality hinted allocation: the hint's own vm page first, then the pages
+ * next to it on the family list (list neighbours, not address neighbours),
+ * and only then the usual biggest free block.
+ */
+static block_meta_data_t *mm_allocate_free_data_block_near(vm_page_family_t *vm_page_family,
+    uint32_t req_size, void *hint_ptr)
+{
+    block_meta_data_t *hint_block = (block_meta_data_t *)((char *)hint_ptr - sizeof(block_meta_data_t));
+    vm_page_t *hint_page = NULL;
+    block_meta_data_t *free_block = NULL;
+
+    /* an out-of-band object has no meta block in front of it to follow */
+    if(mm_is_oob_ptr(hint_ptr))
+        return mm_allocate_free_data_block(vm_page_family, req_size);
+    hint_page = MM_GET_PAGE_FROM_META_BLOCK(hint_block);
+    /* objects of another family can never share a vm page with ours */
+    if(hint_page->page_family != vm_page_family)
+        return mm_allocate_free_data_block(vm_page_family, req_size);
+
+    free_block = mm_find_free_block_near(hint_block, req_size);
+    if(!free_block)
+        free_block = mm_find_free_block_on_vm_page(hint_page->next, req_size);
+    if(!free_block)
+        free_block = mm_find_free_block_on_vm_page(hint_page->prev, req_size);
+    if(!free_block)
+        return mm_allocate_free_data_block(vm_page_family, req_size);
+
+    if(mm_split_free_data_block_for_allocation(vm_page_family, free_block, req_size))
+        return free_block;
+    return NULL;
+}
 
-    vm_page_t *hosting_page = MM_GET_PAGE_FROM_META_BLOCK(to_be_free_block);
-    vm_page_family_t *hosting_page_family = hosting_page->page_family;
-    returning_block = to_be_free_block;
-    to_be_free_block->is_free = MM_TRUE;
+/* Make a fresh page the current region page, reusing a warm one when we can */
+static vm_bool_t mm_region_add_page(vm_page_family_t *vm_page_family)
+{
+    vm_page_t *vm_page = vm_page_family->region_free_pages;
 
-    next_block = NEXT_META_BLOCK(to_be_free_block);
-    prev_block = PREV_META_BLOCK(to_be_free_block);
-    /* Handling Hard Fragmentated memory */
-    if(next_block){
-        /* Scenario #1: When data block to be freed is not the uppermost/last
-         * meta block in the vm page. merge if the next meta block is free.
-        */
-        to_be_free_block->block_size += mm_get_hard_internal_memory_frag_size(to_be_free_block, next_block);
-        printf("%s(): block meta data @ %p of size %u\n", __FUNCTION__, to_be_free_block, to_be_free_block->block_size);
+    if(vm_page){
+        vm_page_family->region_free_pages = vm_page->next;
+        vm_page_family->region_free_page_count--;
+        MARK_VM_PAGE_EMPTY(vm_page);
+        vm_page->prev = NULL;
+        vm_page->next = vm_page_family->first_page;
+        if(vm_page->next)
+            vm_page->next->prev = vm_page;
+        vm_page_family->first_page = vm_page;
     }
     else{
-        /* Scenario #2: when data block is the uppermost/last meta block on the vm page boundary 
-         * merge if there is a hard fragment on the boundary.
-        */
-        char *end_address_of_vm_page = ((char *)hosting_page + SYSTEM_PAGE_SIZE);
-        char *end_address_of_free_data_block = (char *)(to_be_free_block + 1) + to_be_free_block->block_size;
-        int internal_mem_fragmentation = (int)(end_address_of_vm_page - end_address_of_free_data_block);
-        to_be_free_block->block_size += internal_mem_fragmentation;
-        printf("%s(): block meta data @ %p of size %u\n", __FUNCTION__, to_be_free_block, to_be_free_block->block_size);
+        vm_page = mm_allocate_vm_page(vm_page_family);
+        if(!vm_page)
+            return MM_FALSE;
     }
+    /* pages are pushed at the head, the first one of a cycle stays the tail */
+    if(!vm_page->next)
+        vm_page_family->region_tail_page = vm_page;
 
-    /* Perform merging */
-    if(next_block && next_block->is_free == MM_TRUE){
-        mm_union_free_blocks(to_be_free_block, next_block);
-        returning_block = to_be_free_block;
-    }
-    if(prev_block && prev_block->is_free == MM_TRUE){
-        mm_union_free_blocks(prev_block, to_be_free_block);
-        returning_block = prev_block;
-    }
+    vm_page_family->region_cursor = (char *)&vm_page->block_meta_data;
+    vm_page_family->region_end = (char *)vm_page + vm_page->units * SYSTEM_PAGE_SIZE;
+    vm_page_family->region_last_block = NULL;
+    return MM_TRUE;
+}
 
-    if(mm_is_vm_page_empty(hosting_page)){
-        mm_vm_page_delete_and_free(hosting_page);
-        return NULL;
+/* Bump pointer allocation in the current (first) page of a region family. The
+ * meta blocks are still chained so the page walkers keep working, but nothing
+ * ever lands on the free block list: xfree() is a no-op for regions.
+ */
+static void *mm_region_allocate(vm_page_family_t *vm_page_family, uint32_t size, vm_bool_t zero)
+{
+    block_meta_data_t *block_meta_data = (block_meta_data_t *)vm_page_family->region_cursor;
+
+    /* the next meta block, and so every payload, stays max_align_t aligned */
+    size = (size + _Alignof(max_align_t) - 1U) & ~(uint32_t)(_Alignof(max_align_t) - 1U);
+    if(!block_meta_data || (char *)(block_meta_data + 1) + size > vm_page_family->region_end){
+        /* the warm pages may be trimmed by mm_pressure_poll() meanwhile */
+        pthread_mutex_lock(&vm_page_family->family_lock);
+        if(!vm_page_family->region_free_pages && mm_page_family_at_soft_limit(vm_page_family)){
+            /* the callbacks may reset this very region, they run without its lock */
+            pthread_mutex_unlock(&vm_page_family->family_lock);
+            mm_invoke_pressure_callbacks(vm_page_family);
+            pthread_mutex_lock(&vm_page_family->family_lock);
+        }
+        if(!mm_region_add_page(vm_page_family)){
+            pthread_mutex_unlock(&vm_page_family->family_lock);
+            return NULL;
+        }
+        pthread_mutex_unlock(&vm_page_family->family_lock);
+        block_meta_data = (block_meta_data_t *)vm_page_family->region_cursor;
     }
-    /* add the meta data block to the free blocks list */
-    mm_add_free_block_meta_data_to_free_block_list(hosting_page->page_family, returning_block);
-    return returning_block;
+    block_meta_data->is_free = MM_FALSE;
+    block_meta_data->block_size = size;
+    block_meta_data->offset = (uint32_t)((char *)block_meta_data - (char *)vm_page_family->first_page);
+    block_meta_data->prev_block = vm_page_family->region_last_block;
+    block_meta_data->next_block = NULL;
+    init_glthread(&block_meta_data->priority_list_glue);
+    if(block_meta_data->prev_block)
+        block_meta_data->prev_block->next_block = block_meta_data;
+    vm_page_family->region_last_block = block_meta_data;
+    vm_page_family->region_cursor = (char *)(block_meta_data + 1) + size;
+
+    if(zero)
+        memset(block_meta_data + 1, 0, size);
+    return (void *)(block_meta_data + 1);
 }
 
-void xfree(void *app_data){
+/* No memset, no splitting: take the head slot, populating a vm page if the
+ * list ran dry */
+static void *mm_cache_allocate(vm_page_family_t *vm_page_family)
+{
+    glthread_t *glue = glthread_list_dequeue_first(&vm_page_family->free_block_priority_list_head);
+    block_meta_data_t *block_meta_data = NULL;
+    vm_page_t *vm_page = NULL;
 
-    block_meta_data_t *block_meta_data = (block_meta_data_t *)((char *)app_data - sizeof(block_meta_data_t));
-    assert(block_meta_data->is_free == MM_FALSE);
-    mm_free_blocks(block_meta_data);
+    if(!glue){
+        if(mm_page_family_at_soft_limit(vm_page_family)){
+            mm_invoke_pressure_callbacks(vm_page_family);
+            glue = glthread_list_dequeue_first(&vm_page_family->free_block_priority_list_head);
+        }
+        if(!glue && mm_allocate_vm_page(vm_page_family))
+            glue = glthread_list_dequeue_first(&vm_page_family->free_block_priority_list_head);
+        if(!glue)
+            return NULL;
+    }
+    block_meta_data = glue_to_block_metadata(glue);
+    block_meta_data->is_free = MM_FALSE;
+    vm_page = MM_GET_PAGE_FROM_META_BLOCK(block_meta_data);
+    if(vm_page->live_objects++ == 0U && vm_page_family->cache_spare_page == vm_page)
+        vm_page_family->cache_spare_page = NULL;
+    return (void *)(block_meta_data + 1);
 }
 
-void mm_print_block_usage(void)
+/* Destruct every slot of an empty object cache vm page and hand it back */
+static void mm_cache_release_vm_page(vm_page_t *vm_page)
 {
-    vm_page_for_families_t *vm_page_family_base_ptr = NULL;
-    vm_page_family_t *vm_page_family_curr = NULL;
-    vm_page_t *vm_page_curr = NULL;
-    block_meta_data_t *block_meta_data_curr = NULL;
+    vm_page_family_t *vm_page_family = vm_page->page_family;
+    block_meta_data_t *curr = NULL;
 
-    uint32_t total_block_count = 0U;
-    uint32_t free_block_count = 0U;
-    uint32_t occupied_block_count = 0U;
-    uint32_t app_memory_usage = 0U;
+    ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page, curr){
+        glthread_list_remove(&vm_page_family->free_block_priority_list_head, &curr->priority_list_glue);
+        if(vm_page_family->object_dtor)
+            vm_page_family->object_dtor(curr + 1);
+    }ITERATE_VM_PAGE_ALL_BLOCKS_END(vm_page, curr);
+    mm_vm_page_delete_and_free(vm_page);
+}
+
+/* Slots go back constructed. An empty vm page is kept as the family's spare
+ * (or while the family is within its reservation), so a hot xcalloc()/xfree()
+ * pair never rebuilds a page; the next page to empty out is released */
+static void mm_cache_free(block_meta_data_t *block_meta_data)
+{
+    vm_page_t *vm_page = MM_GET_PAGE_FROM_META_BLOCK(block_meta_data);
+    vm_page_family_t *vm_page_family = vm_page->page_family;
+
+    block_meta_data->is_free = MM_TRUE;
+    glthread_list_add_first(&vm_page_family->free_block_priority_list_head, &block_meta_data->priority_list_glue);
+    if(--vm_page->live_objects)
+        return;
+    if(vm_page_family->page_count <= vm_page_family->reserved_page_count)
+        return;
+    if(!vm_page_family->cache_spare_page){
+        vm_page_family->cache_spare_page = vm_page;
+        return;
+    }
+    mm_cache_release_vm_page(vm_page);
+}
+
+/* Out-of-band families. Allocating and freeing only ever write the page's
+ * entry of the metadata table, so data pages stay clean (shared after fork(),
+ * untouched when swapped out) unless the application writes them itself */
+static inline vm_bool_t mm_is_oob_ptr(void *ptr)
+{
+    return mm_oob_arena && (uintptr_t)ptr - (uintptr_t)mm_oob_arena < MM_OOB_ARENA_SIZE;
+}
+
+static vm_bool_t mm_oob_init(void)
+{
+    void *arena = NULL;
+    void *page_meta = NULL;
+
+    pthread_mutex_lock(&mm_oob_mutex);
+    if(mm_oob_arena){
+        pthread_mutex_unlock(&mm_oob_mutex);
+        return MM_TRUE;
+    }
+    arena = mmap(0, MM_OOB_ARENA_SIZE, PROT_NONE, MAP_ANON | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    page_meta = mmap(0, MM_OOB_ARENA_PAGES * sizeof(mm_oob_page_meta_t), PROT_READ | PROT_WRITE,
+                        MAP_ANON | MAP_PRIVATE | MAP_NORESERVE, -1, 0);
+    if(arena == MAP_FAILED || page_meta == MAP_FAILED){
+        printf("Error: %s() - could not reserve the out-of-band arena\n", __FUNCTION__);
+        if(arena != MAP_FAILED)
+            munmap(arena, MM_OOB_ARENA_SIZE);
+        if(page_meta != MAP_FAILED)
+            munmap(page_meta, MM_OOB_ARENA_PAGES * sizeof(mm_oob_page_meta_t));
+        pthread_mutex_unlock(&mm_oob_mutex);
+        return MM_FALSE;
+    }
+    mm_oob_page_meta = (mm_oob_page_meta_t *)page_meta;
+    __atomic_store_n(&mm_oob_arena, (char *)arena, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&mm_oob_mutex);
+    return MM_TRUE;
+}
+
+static void mm_oob_partial_add(vm_page_family_t *vm_page_family, uint32_t page_index)
+{
+    mm_oob_page_meta_t *page_meta = &mm_oob_page_meta[page_index];
+
+    page_meta->prev_partial = MM_OOB_NO_PAGE;
+    page_meta->next_partial = vm_page_family->oob_first_partial;
+    if(page_meta->next_partial != MM_OOB_NO_PAGE)
+        mm_oob_page_meta[page_meta->next_partial].prev_partial = page_index;
+    vm_page_family->oob_first_partial = page_index;
+}
+
+static void mm_oob_partial_remove(vm_page_family_t *vm_page_family, uint32_t page_index)
+{
+    mm_oob_page_meta_t *page_meta = &mm_oob_page_meta[page_index];
+
+    if(page_meta->prev_partial != MM_OOB_NO_PAGE)
+        mm_oob_page_meta[page_meta->prev_partial].next_partial = page_meta->next_partial;
+    else
+        vm_page_family->oob_first_partial = page_meta->next_partial;
+    if(page_meta->next_partial != MM_OOB_NO_PAGE)
+        mm_oob_page_meta[page_meta->next_partial].prev_partial = page_meta->prev_partial;
+}
+
+static inline uint32_t mm_oob_slot_count(vm_page_family_t *vm_page_family)
+{
+    uint32_t slot_count = SYSTEM_PAGE_SIZE / vm_page_family->oob_slot_size;
+    return slot_count > MM_OOB_MAX_SLOTS ? MM_OOB_MAX_SLOTS : slot_count;
+}
+
+/* Back one more arena page for the family, all of its slots free */
+static uint32_t mm_oob_add_page(vm_page_family_t *vm_page_family, vm_bool_t populate)
+{
+    mm_oob_page_meta_t *page_meta = NULL;
+    uint32_t page_index = MM_OOB_NO_PAGE;
+    uint32_t slot_count = 0U;
+    uint32_t i = 0U;
+    void *page = NULL;
+
+    if(mm_page_family_at_hard_limit(vm_page_family) || !mm_global_reserve_pages(1U)){
+        printf("Error: %s() - page family %s reached its memory limit\n", __FUNCTION__, vm_page_family->struct_name);
+        return MM_OOB_NO_PAGE;
+    }
+    pthread_mutex_lock(&mm_oob_mutex);
+    if(mm_oob_free_page != MM_OOB_NO_PAGE){
+        page_index = mm_oob_free_page;
+        mm_oob_free_page = mm_oob_page_meta[page_index].next_partial;
+    }
+    else if(mm_oob_next_page < MM_OOB_ARENA_PAGES){
+        page_index = mm_oob_next_page;
+        __atomic_store_n(&mm_oob_next_page, page_index + 1U, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&mm_oob_mutex);
+    if(page_index == MM_OOB_NO_PAGE){
+        printf("Error: %s() - out-of-band arena exhausted\n", __FUNCTION__);
+        mm_global_unreserve_pages(1U);
+        return MM_OOB_NO_PAGE;
+    }
+
+    page = mmap(mm_oob_arena + (size_t)page_index * SYSTEM_PAGE_SIZE, SYSTEM_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                MAP_ANON | MAP_PRIVATE | MAP_FIXED | (populate ? MAP_POPULATE : 0), -1, 0);
+    if(page == MAP_FAILED){
+        printf("Error: VM Page allocation failed\n");
+        pthread_mutex_lock(&mm_oob_mutex);
+        mm_oob_page_meta[page_index].next_partial = mm_oob_free_page;
+        mm_oob_free_page = page_index;
+        pthread_mutex_unlock(&mm_oob_mutex);
+        mm_global_unreserve_pages(1U);
+        return MM_OOB_NO_PAGE;
+    }
+    __atomic_add_fetch(&mm_vm_pages_allocated, 1U, __ATOMIC_RELAXED);
+    vm_page_family->page_count++;
+
+    slot_count = mm_oob_slot_count(vm_page_family);
+    page_meta = &mm_oob_page_meta[page_index];
+    page_meta->live_objects = 0U;
+    page_meta->slot_count = (uint16_t)slot_count;
+    for(i = 0U; i < MM_OOB_MAX_SLOTS / 64U; i++){
+        if(slot_count >= (i + 1U) * 64U)
+            page_meta->free_slots[i] = UINT64_MAX;
+        else if(slot_count > i * 64U)
+            page_meta->free_slots[i] = (1ULL << (slot_count - i * 64U)) - 1U;
+        else
+            page_meta->free_slots[i] = 0U;
+    }
+    __atomic_store_n(&page_meta->page_family, vm_page_family, __ATOMIC_RELEASE);
+    mm_oob_partial_add(vm_page_family, page_index);
+    return page_index;
+}
+
+/* Drop the backing of an empty page, its address range stays reserved */
+static void mm_oob_remove_page(vm_page_family_t *vm_page_family, uint32_t page_index)
+{
+    mm_oob_partial_remove(vm_page_family, page_index);
+    __atomic_store_n(&mm_oob_page_meta[page_index].page_family, NULL, __ATOMIC_RELEASE);
+    if(mmap(mm_oob_arena + (size_t)page_index * SYSTEM_PAGE_SIZE, SYSTEM_PAGE_SIZE, PROT_NONE,
+            MAP_ANON | MAP_PRIVATE | MAP_FIXED | MAP_NORESERVE, -1, 0) == MAP_FAILED){
+        printf("Error: could not unmap VM page back to kernel\n");
+    }
+    vm_page_family->page_count--;
+    __atomic_sub_fetch(&mm_total_page_count, 1U, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&mm_vm_pages_returned, 1U, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&mm_oob_mutex);
+    mm_oob_page_meta[page_index].next_partial = mm_oob_free_page;
+    mm_oob_free_page = page_index;
+    pthread_mutex_unlock(&mm_oob_mutex);
+}
+
+static void *mm_oob_allocate(vm_page_family_t *vm_page_family, vm_bool_t zero)
+{
+    uint32_t page_index = vm_page_family->oob_first_partial;
+    mm_oob_page_meta_t *page_meta = NULL;
+    uint32_t word = 0U;
+    uint32_t slot = 0U;
+    char *object = NULL;
+
+    if(page_index == MM_OOB_NO_PAGE){
+        if(mm_page_family_at_soft_limit(vm_page_family)){
+            mm_invoke_pressure_callbacks(vm_page_family);
+            page_index = vm_page_family->oob_first_partial;
+        }
+        if(page_index == MM_OOB_NO_PAGE)
+            page_index = mm_oob_add_page(vm_page_family, MM_FALSE);
+        if(page_index == MM_OOB_NO_PAGE)
+            return NULL;
+    }
+    page_meta = &mm_oob_page_meta[page_index];
+    while(!page_meta->free_slots[word])
+        word++;
+    slot = word * 64U + (uint32_t)__builtin_ctzll(page_meta->free_slots[word]);
+    page_meta->free_slots[word] &= page_meta->free_slots[word] - 1U;
+    if(++page_meta->live_objects == page_meta->slot_count)
+        mm_oob_partial_remove(vm_page_family, page_index);
+
+    object = mm_oob_arena + (size_t)page_index * SYSTEM_PAGE_SIZE + slot * vm_page_family->oob_slot_size;
+    if(zero)
+        memset(object, 0, vm_page_family->struct_size);
+    return (void *)object;
+}
+
+static void mm_oob_free(vm_page_family_t *vm_page_family, void *ptr)
+{
+    uintptr_t offset = (uintptr_t)ptr - (uintptr_t)mm_oob_arena;
+    uint32_t page_index = (uint32_t)(offset / SYSTEM_PAGE_SIZE);
+    uint32_t slot = (uint32_t)(offset % SYSTEM_PAGE_SIZE) / vm_page_family->oob_slot_size;
+    mm_oob_page_meta_t *page_meta = &mm_oob_page_meta[page_index];
+    uint64_t mask = 1ULL << (slot % 64U);
+
+    assert(!(page_meta->free_slots[slot / 64U] & mask));
+    page_meta->free_slots[slot / 64U] |= mask;
+    if(page_meta->live_objects-- == page_meta->slot_count)
+        mm_oob_partial_add(vm_page_family, page_index);
+    if(!page_meta->live_objects && vm_page_family->page_count > vm_page_family->reserved_page_count)
+        mm_oob_remove_page(vm_page_family, page_index);
+}
+
+/* Frees from non owner threads are chained through the dead object itself:
+ * the one write to a data page on this path, and only cross thread */
+static void mm_oob_xfree(void *ptr)
+{
+    uint32_t page_index = (uint32_t)(((uintptr_t)ptr - (uintptr_t)mm_oob_arena) / SYSTEM_PAGE_SIZE);
+    vm_page_family_t *vm_page_family = __atomic_load_n(&mm_oob_page_meta[page_index].page_family, __ATOMIC_ACQUIRE);
+    void *head = NULL;
+
+    assert(vm_page_family);
+    MM_TRACE(MM_TRACE_OP_FREE, vm_page_family, 0U, ptr);
+    if(mm_is_remote_free(vm_page_family)){
+        head = __atomic_load_n(&vm_page_family->oob_remote_free_head, __ATOMIC_RELAXED);
+        do{
+            *(void **)ptr = head;
+        }while(!__atomic_compare_exchange_n(&vm_page_family->oob_remote_free_head, &head, ptr,
+                                            MM_TRUE, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+        return;
+    }
+    mm_oob_free(vm_page_family, ptr);
+}
+
+static uint32_t mm_oob_drain_remote_frees(vm_page_family_t *vm_page_family)
+{
+    uint32_t count = 0U;
+    void *next = NULL;
+    void *curr = __atomic_exchange_n(&vm_page_family->oob_remote_free_head, NULL, __ATOMIC_ACQUIRE);
+
+    for(; curr; curr = next, count++){
+        next = *(void **)curr;
+        mm_oob_free(vm_page_family, curr);
+    }
+    return count;
+}
+
+static void mm_oob_block_usage(vm_page_family_t *vm_page_family, uint32_t *total_block_count,
+    uint32_t *free_block_count, uint32_t *occupied_block_count, uint32_t *app_memory_usage)
+{
+    uint32_t n_pages = __atomic_load_n(&mm_oob_next_page, __ATOMIC_ACQUIRE);
+    uint32_t page_index = 0U;
+
+    for(page_index = 0U; page_index < n_pages; page_index++){
+        if(mm_oob_page_meta[page_index].page_family != vm_page_family)
+            continue;
+        *total_block_count += mm_oob_page_meta[page_index].slot_count;
+        *occupied_block_count += mm_oob_page_meta[page_index].live_objects;
+        *free_block_count += mm_oob_page_meta[page_index].slot_count - mm_oob_page_meta[page_index].live_objects;
+        *app_memory_usage += mm_oob_page_meta[page_index].live_objects * vm_page_family->oob_slot_size;
+    }
+}
+
+/* Objects in address order, reading nothing but the metadata table */
+static uint64_t mm_oob_for_each_object(vm_page_family_t *vm_page_family, mm_object_cb_t cb, void *ctx)
+{
+    uint32_t n_pages = __atomic_load_n(&mm_oob_next_page, __ATOMIC_ACQUIRE);
+    mm_oob_page_meta_t *page_meta = NULL;
+    uint32_t page_index = 0U;
+    uint32_t slot = 0U;
+    uint64_t count = 0U;
+
+    /* remote frees are still live in the bitmap until drained; the owner
+     * may drain, and anyone may drain an orphaned family under its lock */
+    if(mm_page_family_is_owner(vm_page_family) || __atomic_load_n(&vm_page_family->orphaned, __ATOMIC_ACQUIRE))
+        mm_drain_remote_frees(vm_page_family);
+    for(page_index = 0U; page_index < n_pages; page_index++){
+        page_meta = &mm_oob_page_meta[page_index];
+        if(page_meta->page_family != vm_page_family)
+            continue;
+        for(slot = 0U; slot < page_meta->slot_count; slot++){
+            if(page_meta->free_slots[slot / 64U] & (1ULL << (slot % 64U)))
+                continue;
+            cb(mm_oob_arena + (size_t)page_index * SYSTEM_PAGE_SIZE + slot * vm_page_family->oob_slot_size, ctx);
+            count++;
+        }
+    }
+    return count;
+}
+
+static void *mm_allocate_from_page_family(vm_page_family_t *page_family, int units, vm_bool_t zero,
+    void *hint_ptr);
+static uint32_t mm_page_family_trim_locked(vm_page_family_t *vm_page_family);
+
+/* Sharded families: the registered family fronts one general family per CPU
+ * and xcalloc() picks the shard of the CPU the caller runs on. A shard is
+ * guarded by its family lock instead of an owner thread, taken by every
+ * xcalloc() and xfree() (one atomic each way when uncontended) and by the
+ * walkers; it is only contended after a migration, by another CPU stealing
+ * from it or by a free from another CPU. The CPU number only picks the
+ * shard, nothing relies on staying on that CPU */
+static inline uint32_t mm_current_cpu(void)
+{
+    int cpu = -1;
+
+#ifdef MM_HAVE_RSEQ
+    /* the kernel keeps cpu_id of the rseq area glibc registered for this thread current */
+    if(__rseq_size){
+        struct rseq *rseq_area = (struct rseq *)((char *)__builtin_thread_pointer() + __rseq_offset);
+        cpu = (int)__atomic_load_n(&rseq_area->cpu_id, __ATOMIC_RELAXED);
+    }
+#endif
+    if(cpu < 0)
+        cpu = sched_getcpu();
+    return cpu < 0 ? 0U : (uint32_t)cpu;
+}
+
+static inline vm_bool_t mm_shard_has_room(vm_page_family_t *shard, uint32_t size)
+{
+    block_meta_data_t *biggest_block_meta_data = mm_get_biggest_free_block_page_family(shard);
+
+    return (biggest_block_meta_data && biggest_block_meta_data->block_size >= size) ? MM_TRUE : MM_FALSE;
+}
+
+/* Home shard first; once it runs dry, a block another shard has spare beats
+ * mapping a new vm page. Victims are only tried, never waited for. The
+ * pressure callbacks get the parent and run without the shard lock, they
+ * may well free into this shard */
+static void *mm_shard_allocate(vm_page_family_t *vm_page_family, int units, vm_bool_t zero, void *hint_ptr)
+{
+    uint32_t size = units * vm_page_family->struct_size;
+    uint32_t home = mm_current_cpu() % vm_page_family->shard_count;
+    vm_page_family_t *shard = vm_page_family->shards[home];
+    vm_page_family_t *victim = NULL;
+    vm_bool_t asked = MM_FALSE;
+    void *object = NULL;
+    uint32_t i = 0U;
+
+    pthread_mutex_lock(&shard->family_lock);
+    while(!mm_shard_has_room(shard, size)){
+        for(i = 1U; i < vm_page_family->shard_count && !object; i++){
+            victim = vm_page_family->shards[(home + i) % vm_page_family->shard_count];
+            if(pthread_mutex_trylock(&victim->family_lock))
+                continue;
+            if(mm_shard_has_room(victim, size))
+                object = mm_allocate_from_page_family(victim, units, zero, hint_ptr);
+            pthread_mutex_unlock(&victim->family_lock);
+        }
+        if(object || asked || !mm_page_family_at_soft_limit(vm_page_family))
+            break;
+        pthread_mutex_unlock(&shard->family_lock);
+        mm_invoke_pressure_callbacks(vm_page_family);
+        asked = MM_TRUE;
+        pthread_mutex_lock(&shard->family_lock);
+    }
+    if(!object)
+        object = mm_allocate_from_page_family(shard, units, zero, hint_ptr);
+    pthread_mutex_unlock(&shard->family_lock);
+    return object;
+}
+
+static void *mm_allocate_from_page_family(vm_page_family_t *page_family, int units, vm_bool_t zero,
+    void *hint_ptr)
+{
+    /* check if the requested memory fits with-in a vm page */
+    if((page_family->struct_size * units) > mm_max_page_allocatable_memory(page_family->page_span)){
+        printf("Error: Memory requested exceeds page size\n");
+        return NULL;
+    }
+
+    /* a pressure poll asked every family to give back what it is holding on to */
+    if(__atomic_load_n(&mm_trim_epoch, __ATOMIC_RELAXED) != __atomic_load_n(&page_family->trim_epoch, __ATOMIC_RELAXED)){
+        /* a shard's lock is already held */
+        if(page_family->shard_parent)
+            mm_page_family_trim_locked(page_family);
+        else
+            mm_page_family_trim(page_family);
+    }
+
+    if(page_family->family_type == MM_PAGE_FAMILY_SHARDED)
+        return mm_shard_allocate(page_family, units, zero, hint_ptr);
+
+    if(page_family->family_type == MM_PAGE_FAMILY_REGION){
+        void *object = mm_region_allocate(page_family, units * page_family->struct_size, zero);
+        if(object)
+            MM_TRACE(MM_TRACE_OP_ALLOC, page_family, units, object);
+        return object;
+    }
+
+    /* the first allocating thread owns the family, frees from anyone else are
+     * deferred; the next one to allocate adopts an orphaned family. Shards
+     * have their lock instead */
+    if(!page_family->shard_parent && (!__atomic_load_n(&page_family->owner_bound, __ATOMIC_ACQUIRE) ||
+        __atomic_load_n(&page_family->orphaned, __ATOMIC_ACQUIRE)))
+        mm_page_family_bind_owner(page_family);
+
+    /* coalesce the blocks other threads handed back since our last visit */
+    if(__atomic_load_n(&page_family->remote_free_head, __ATOMIC_RELAXED))
+        mm_drain_remote_frees(page_family);
+
+    if(page_family->family_type == MM_PAGE_FAMILY_OUT_OF_BAND){
+        void *object = NULL;
+        if(units != 1){
+            printf("Error: %s() - out-of-band family %s allocates one object at a time\n",
+                __FUNCTION__, page_family->struct_name);
+            return NULL;
+        }
+        if(__atomic_load_n(&page_family->oob_remote_free_head, __ATOMIC_RELAXED))
+            mm_oob_drain_remote_frees(page_family);
+        object = mm_oob_allocate(page_family, zero);
+        if(object)
+            MM_TRACE(MM_TRACE_OP_ALLOC, page_family, units, object);
+        return object;
+    }
+
+    /* objects come back constructed, never zeroed */
+    if(page_family->family_type == MM_PAGE_FAMILY_OBJECT_CACHE){
+        void *object = NULL;
+        if(units != 1){
+            printf("Error: %s() - object cache family %s allocates one object at a time\n",
+                __FUNCTION__, page_family->struct_name);
+            return NULL;
+        }
+        object = mm_cache_allocate(page_family);
+        if(object){
+            MM_TAG_ALLOC((block_meta_data_t *)object - 1);
+            MM_TRACE(MM_TRACE_OP_ALLOC, page_family, units, object);
+        }
+        return object;
+    }
+
+    /* find a data block which can satisfy the request */
+    block_meta_data_t *free_block_meta_data = hint_ptr ?
+        mm_allocate_free_data_block_near(page_family, (units * page_family->struct_size), hint_ptr) :
+        mm_allocate_free_data_block(page_family, (units * page_family->struct_size));
+    if(free_block_meta_data){
+        if(zero)
+            memset((char *)(free_block_meta_data + 1), 0, free_block_meta_data->block_size);
+        MM_TAG_ALLOC(free_block_meta_data);
+        MM_TRACE(MM_TRACE_OP_ALLOC, page_family, units, free_block_meta_data + 1);
+        return (void *)(free_block_meta_data + 1);
+    }
+    mm_print_vm_page_priority_queue(page_family);
+    return NULL;
+}
+
+void *xcalloc_page_family(vm_page_family_t *page_family, int units)
+{
+    return mm_allocate_from_page_family(page_family, units, MM_TRUE, NULL);
+}
+
+void *xcalloc_page_family_near(vm_page_family_t *page_family, void *hint_ptr, int units)
+{
+    return mm_allocate_from_page_family(page_family, units, MM_TRUE, hint_ptr);
+}
+
+void *xcalloc_near(void *hint_ptr, char *struct_name, int units)
+{
+    vm_page_family_t *page_family = mm_lookup_page_family_by_name(struct_name);
+    if(!page_family){
+        printf("Error: Structure %s is not registered with memory manager\n", struct_name);
+        return NULL;
+    }
+    return mm_allocate_from_page_family(page_family, units, MM_TRUE, hint_ptr);
+}
+
+/* Requests beyond the biggest size class get a private mapping. The vm page
+ * header is laid out as usual with no page family, the meta block sits right
+ * in front of the (aligned) payload and its offset leads back to the header.
+ */
+static void *mm_allocate_huge_block(size_t size, size_t alignment)
+{
+    size_t header = offset_of(vm_page_t, page_memory);
+    size_t units = (header + alignment + size + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE;
+    vm_page_t *vm_page = NULL;
+    block_meta_data_t *block_meta_data = NULL;
+    uintptr_t payload;
+
+    if(size > UINT32_MAX - SYSTEM_PAGE_SIZE)
+        return NULL;
+    if(!mm_global_reserve_pages((uint32_t)units))
+        return NULL;
+
+    /* anonymous memory is already zero, leave it to fault in lazily */
+    vm_page = mmap(0, units * SYSTEM_PAGE_SIZE, PROT_READ | PROT_WRITE,
+                    MAP_ANON | MAP_PRIVATE, -1, 0);
+    if(vm_page == MAP_FAILED){
+        mm_global_unreserve_pages((uint32_t)units);
+        return NULL;
+    }
+
+    vm_page->next = NULL;
+    vm_page->prev = NULL;
+    vm_page->page_family = NULL;
+    vm_page->units = (uint32_t)units;
+    MM_TAG_PAGE_ALLOC(vm_page);
+
+    payload = ((uintptr_t)vm_page + header + alignment - 1) & ~((uintptr_t)alignment - 1);
+    block_meta_data = (block_meta_data_t *)payload - 1;
+    block_meta_data->is_free = MM_FALSE;
+    block_meta_data->block_size = (uint32_t)size;
+    block_meta_data->offset = (uint32_t)((char *)block_meta_data - (char *)vm_page);
+    block_meta_data->prev_block = NULL;
+    block_meta_data->next_block = NULL;
+    init_glthread(&block_meta_data->priority_list_glue);
+    MM_TAG_ALLOC(block_meta_data);
+    MM_TRACE(MM_TRACE_OP_ALLOC, NULL, (uint32_t)size, (void *)payload);
+    return (void *)payload;
+}
+
+static void mm_free_huge_block(vm_page_t *vm_page)
+{
+    mm_release_vm_page(vm_page);
+}
+
+static inline uint32_t mm_size_class_index(size_t size)
+{
+    if(size <= MM_SIZE_CLASS_MIN)
+        return 0U;
+    /* ceil(log2(size)) - log2(MM_SIZE_CLASS_MIN) */
+    return (uint32_t)(64 - __builtin_clzll((unsigned long long)(size - 1))) - MM_SIZE_CLASS_MIN_SHIFT;
+}
+
+static vm_page_family_t *mm_size_class_family(uint32_t index)
+{
+    char struct_name[MM_MAX_STRUCT_NAME];
+    vm_page_family_t *vm_page_family = mm_size_class_families[index];
+
+    if(vm_page_family)
+        return vm_page_family;
+    snprintf(struct_name, sizeof(struct_name), "mm_size_%u", MM_SIZE_CLASS_MIN << index);
+    vm_page_family = mm_instantiate_new_page_family(struct_name, MM_SIZE_CLASS_MIN << index);
+    mm_size_class_families[index] = vm_page_family;
+    return vm_page_family;
+}
+
+void *xmalloc(size_t size)
+{
+    vm_page_family_t *vm_page_family = NULL;
+
+    if(size > MM_SIZE_CLASS_MAX)
+        return mm_allocate_huge_block(size, MM_MALLOC_ALIGNMENT);
+    vm_page_family = mm_size_class_family(mm_size_class_index(size));
+    if(!vm_page_family)
+        return NULL;
+    return mm_allocate_from_page_family(vm_page_family, 1, MM_FALSE, NULL);
+}
+
+static block_meta_data_t *mm_free_blocks(block_meta_data_t *to_be_free_block);
+
+/* An aligned block out of a size class: a block big enough to hold one at
+ * any misalignment is split at the aligned address, and the head goes back
+ * to the family like a freed block */
+static void *mm_allocate_aligned_size_class_block(size_t alignment, size_t size)
+{
+    char *ptr = xmalloc(size + alignment + sizeof(block_meta_data_t));
+    block_meta_data_t *head = NULL;
+    block_meta_data_t *tail = NULL;
+    vm_page_family_t *vm_page_family = NULL;
+    uintptr_t aligned;
+
+    if(!ptr || !((uintptr_t)ptr & (alignment - 1)))
+        return ptr;
+    head = (block_meta_data_t *)ptr - 1;
+    vm_page_family = ((vm_page_t *)MM_GET_PAGE_FROM_META_BLOCK(head))->page_family;
+    /* room for the tail's meta block and a minimal head payload */
+    aligned = ((uintptr_t)ptr + sizeof(block_meta_data_t) + MM_MALLOC_ALIGNMENT + alignment - 1) &
+              ~((uintptr_t)alignment - 1);
+    tail = (block_meta_data_t *)aligned - 1;
+
+    MM_TAG_FREE(head);
+    tail->is_free = MM_FALSE;
+    tail->block_size = head->block_size - (uint32_t)(aligned - (uintptr_t)ptr);
+    tail->offset = head->offset + (uint32_t)((char *)tail - (char *)head);
+    init_glthread(&tail->priority_list_glue);
+    head->block_size = (uint32_t)((char *)tail - ptr);
+    mm_bind_split_blocks_after_allocation(head, tail);
+    MM_TAG_ALLOC(tail);
+    mm_free_blocks(head);
+    MM_TRACE(MM_TRACE_OP_FREE, vm_page_family, 0U, ptr);
+    MM_TRACE(MM_TRACE_OP_ALLOC, vm_page_family, 1U, (void *)aligned);
+    return (void *)aligned;
+}
+
+void *xmemalign(size_t alignment, size_t size)
+{
+    if(alignment <= MM_MALLOC_ALIGNMENT)
+        return xmalloc(size);
+    if(alignment < SYSTEM_PAGE_SIZE && size + alignment + sizeof(block_meta_data_t) <= MM_SIZE_CLASS_MAX)
+        return mm_allocate_aligned_size_class_block(alignment, size);
+    /* too big for a size class block, it has to be a private mapping */
+    return mm_allocate_huge_block(size, alignment);
+}
+
+void *xrealloc(void *ptr, size_t size)
+{
+    void *new_ptr = NULL;
+    size_t old_size;
+
+    if(!ptr)
+        return xmalloc(size);
+    old_size = xmalloc_usable_size(ptr);
+    /* shrinking, or growing within the slack of the block, stays in place */
+    if(size <= old_size && size > old_size / 2)
+        return ptr;
+    new_ptr = xmalloc(size);
+    if(!new_ptr)
+        return NULL;
+    memcpy(new_ptr, ptr, size < old_size ? size : old_size);
+    xfree(ptr);
+    return new_ptr;
+}
+
+size_t xmalloc_usable_size(void *ptr)
+{
+    if(mm_is_oob_ptr(ptr)){
+        uint32_t page_index = (uint32_t)(((uintptr_t)ptr - (uintptr_t)mm_oob_arena) / SYSTEM_PAGE_SIZE);
+        return mm_oob_page_meta[page_index].page_family->struct_size;
+    }
+    block_meta_data_t *block_meta_data = (block_meta_data_t *)((char *)ptr - sizeof(block_meta_data_t));
+    return block_meta_data->block_size;
+}
+
+static int mm_get_hard_internal_memory_frag_size(block_meta_data_t *first, block_meta_data_t *second)
+{
+    //assert(first || second);
+    /* confirm the existance of a hard fragmented memory between first and second arguments */
+    //assert(first->is_free == MM_TRUE || second->is_free == MM_TRUE);
+
+    block_meta_data_t *next_block = NEXT_META_BLOCK_BY_SIZE(first);
+    return (int)((char *)second - (char *)next_block);
+}
+
+static block_meta_data_t *mm_free_blocks(block_meta_data_t *to_be_free_block){
+
+    block_meta_data_t *returning_block = NULL;
+    block_meta_data_t *next_block = NULL;
+    block_meta_data_t *prev_block = NULL;
+    assert(to_be_free_block->is_free == MM_FALSE);
+
+    vm_page_t *hosting_page = MM_GET_PAGE_FROM_META_BLOCK(to_be_free_block);
+    vm_page_family_t *hosting_page_family = hosting_page->page_family;
+    returning_block = to_be_free_block;
+    to_be_free_block->is_free = MM_TRUE;
+
+    next_block = NEXT_META_BLOCK(to_be_free_block);
+    prev_block = PREV_META_BLOCK(to_be_free_block);
+    /* Handling Hard Fragmentated memory */
+    if(next_block){
+        /* Scenario #1: When data block to be freed is not the uppermost/last
+         * meta block in the vm page. merge if the next meta block is free.
+        */
+        to_be_free_block->block_size += mm_get_hard_internal_memory_frag_size(to_be_free_block, next_block);
+        printf("%s(): block meta data @ %p of size %u\n", __FUNCTION__, to_be_free_block, to_be_free_block->block_size);
+    }
+    else{
+        /* Scenario #2: when data block is the uppermost/last meta block on the vm page boundary 
+         * merge if there is a hard fragment on the boundary.
+        */
+        char *end_address_of_vm_page = ((char *)hosting_page + hosting_page->units * SYSTEM_PAGE_SIZE);
+        char *end_address_of_free_data_block = (char *)(to_be_free_block + 1) + to_be_free_block->block_size;
+        int internal_mem_fragmentation = (int)(end_address_of_vm_page - end_address_of_free_data_block);
+        to_be_free_block->block_size += internal_mem_fragmentation;
+        printf("%s(): block meta data @ %p of size %u\n", __FUNCTION__, to_be_free_block, to_be_free_block->block_size);
+    }
+
+    /* Perform merging */
+    if(next_block && next_block->is_free == MM_TRUE){
+        mm_union_free_blocks(to_be_free_block, next_block);
+        returning_block = to_be_free_block;
+    }
+    if(prev_block && prev_block->is_free == MM_TRUE){
+        mm_union_free_blocks(prev_block, to_be_free_block);
+        returning_block = prev_block;
+    }
+
+    /* reserved pages stay mapped even when empty */
+    if(mm_is_vm_page_empty(hosting_page) &&
+        hosting_page_family->page_count > hosting_page_family->reserved_page_count){
+        mm_vm_page_delete_and_free(hosting_page);
+        return NULL;
+    }
+    /* add the meta data block to the free blocks list */
+    mm_add_free_block_meta_data_to_free_block_list(hosting_page->page_family, returning_block);
+    return returning_block;
+}
+
+void xfree(void *app_data){
+
+    /* out-of-band pages have nothing in front of the object, check before touching it */
+    if(mm_is_oob_ptr(app_data)){
+        mm_oob_xfree(app_data);
+        return;
+    }
+    block_meta_data_t *block_meta_data = (block_meta_data_t *)((char *)app_data - sizeof(block_meta_data_t));
+    assert(block_meta_data->is_free == MM_FALSE);
+    vm_page_t *hosting_page = MM_GET_PAGE_FROM_META_BLOCK(block_meta_data);
+    vm_page_family_t *hosting_page_family = hosting_page->page_family;
+
+    MM_TRACE(MM_TRACE_OP_FREE, hosting_page_family, 0U, app_data);
+    if(!hosting_page_family){
+        MM_TAG_FREE(block_meta_data);
+        mm_free_huge_block(hosting_page);
+        return;
+    }
+    /* region objects go away all at once, in mm_region_reset() */
+    if(hosting_page_family->family_type == MM_PAGE_FAMILY_REGION)
+        return;
+    MM_TAG_FREE(block_meta_data);
+    if(hosting_page_family->shard_parent){
+        pthread_mutex_lock(&hosting_page_family->family_lock);
+        mm_free_blocks(block_meta_data);
+        pthread_mutex_unlock(&hosting_page_family->family_lock);
+        return;
+    }
+    if(mm_is_remote_free(hosting_page_family)){
+        mm_remote_free_push(hosting_page_family, block_meta_data);
+        return;
+    }
+    if(hosting_page_family->family_type == MM_PAGE_FAMILY_OBJECT_CACHE){
+        mm_cache_free(block_meta_data);
+        return;
+    }
+    mm_free_blocks(block_meta_data);
+}
+
+mm_tag_t mm_set_current_tag(mm_tag_t tag)
+{
+#ifndef MM_NO_TAGS
+    mm_tag_t prev_tag = mm_current_tag;
+
+    if(tag >= MM_MAX_TAGS){
+        printf("Error: %s() - tag %u out of range\n", __FUNCTION__, tag);
+        return prev_tag;
+    }
+    mm_current_tag = tag;
+    return prev_tag;
+#else
+    return MM_TAG_UNTAGGED;
+#endif
+}
+
+mm_tag_t mm_get_current_tag(void)
+{
+#ifndef MM_NO_TAGS
+    return mm_current_tag;
+#else
+    return MM_TAG_UNTAGGED;
+#endif
+}
+
+void *xcalloc_tagged(char *struct_name, int units, mm_tag_t tag)
+{
+    mm_tag_t prev_tag = mm_set_current_tag(tag);
+    void *ptr = xcalloc(struct_name, units);
+    mm_set_current_tag(prev_tag);
+    return ptr;
+}
+
+#ifndef MM_NO_TAGS
+/* The thread is gone, later frees from its TLS destructors go to the shared
+ * counters so the block never has two writers */
+static void mm_tag_thread_exit(void *arg)
+{
+    mm_tag_deltas_t *deltas = arg;
+
+    mm_tag_thread_deltas = NULL;
+    mm_tag_thread_shared = MM_TRUE;
+    __atomic_store_n(&deltas->in_use, MM_FALSE, __ATOMIC_RELEASE);
+}
+
+static void mm_tag_exit_key_create(void)
+{
+    if(pthread_key_create(&mm_tag_exit_key, mm_tag_thread_exit))
+        printf("Error: %s() - tags will be counted in shared counters\n", __FUNCTION__);
+}
+
+/* First charge or credit of a thread. A block is only handed out with its
+ * exit hook armed. Like the owner exit hook, it is not armed without remote
+ * frees: the preload shim turns them off because pthread_setspecific() may
+ * allocate, and serialises every call anyway */
+static mm_tag_deltas_t *mm_tag_claim_thread_deltas(void)
+{
+    mm_tag_deltas_t *deltas = NULL;
+    vm_bool_t in_use = MM_FALSE;
+
+    if(mm_tag_thread_shared)
+        return NULL;
+    mm_tag_thread_shared = MM_TRUE;
+    if(!mm_remote_free_enabled)
+        return NULL;
+    pthread_once(&mm_tag_exit_once, mm_tag_exit_key_create);
+
+    for(deltas = __atomic_load_n(&mm_tag_deltas_list, __ATOMIC_ACQUIRE); deltas; deltas = deltas->next){
+        in_use = MM_FALSE;
+        if(__atomic_compare_exchange_n(&deltas->in_use, &in_use, MM_TRUE, MM_FALSE,
+                                       __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+            break;
+    }
+    if(!deltas){
+        deltas = mm_get_scratch_vm_pages((int)((sizeof(mm_tag_deltas_t) + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE));
+        if(!deltas)
+            return NULL;
+        deltas->in_use = MM_TRUE;
+        deltas->next = __atomic_load_n(&mm_tag_deltas_list, __ATOMIC_RELAXED);
+        while(!__atomic_compare_exchange_n(&mm_tag_deltas_list, &deltas->next, deltas, MM_TRUE,
+                                           __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+    }
+    if(pthread_setspecific(mm_tag_exit_key, deltas)){
+        __atomic_store_n(&deltas->in_use, MM_FALSE, __ATOMIC_RELEASE);
+        return NULL;
+    }
+    mm_tag_thread_deltas = deltas;
+    mm_tag_thread_shared = MM_FALSE;
+    return deltas;
+}
+#endif
+
+/* A snapshot: charges and credits made on other threads meanwhile may or may
+ * not be in it, it is exact while they are quiescent */
+void mm_get_tag_stats(mm_tag_t tag, mm_tag_stats_t *stats)
+{
+#ifndef MM_NO_TAGS
+    mm_tag_deltas_t *deltas = NULL;
+    int64_t live_bytes, live_objects;
+#endif
+
+    memset(stats, 0, sizeof(*stats));
+#ifndef MM_NO_TAGS
+    if(tag >= MM_MAX_TAGS)
+        return;
+    live_bytes = (int64_t)__atomic_load_n(&mm_tag_counters[tag].live_bytes, __ATOMIC_RELAXED);
+    live_objects = (int64_t)__atomic_load_n(&mm_tag_counters[tag].live_objects, __ATOMIC_RELAXED);
+    for(deltas = __atomic_load_n(&mm_tag_deltas_list, __ATOMIC_ACQUIRE); deltas; deltas = deltas->next){
+        live_bytes += __atomic_load_n(&deltas->live_bytes[tag], __ATOMIC_RELAXED);
+        live_objects += __atomic_load_n(&deltas->live_objects[tag], __ATOMIC_RELAXED);
+    }
+    /* a credit seen before its charge */
+    stats->live_bytes = live_bytes > 0 ? (uint64_t)live_bytes : 0U;
+    stats->live_objects = live_objects > 0 ? (uint64_t)live_objects : 0U;
+    stats->vm_pages = __atomic_load_n(&mm_tag_counters[tag].vm_pages, __ATOMIC_RELAXED);
+#endif
+}
+
+void mm_set_remote_free_mode(vm_bool_t enable)
+{
+    mm_remote_free_enabled = enable;
+}
+
+static uint32_t mm_pop_remote_frees(vm_page_family_t *vm_page_family)
+{
+    uint32_t count = 0U;
+    glthread_t *next_glue = NULL;
+    block_meta_data_t *curr = NULL;
+
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_OUT_OF_BAND)
+        return mm_oob_drain_remote_frees(vm_page_family);
+    curr = __atomic_exchange_n(&vm_page_family->remote_free_head, NULL, __ATOMIC_ACQUIRE);
+    while(curr){
+        next_glue = curr->priority_list_glue.right;
+        init_glthread(&curr->priority_list_glue);
+        curr->is_free = MM_FALSE;
+        if(vm_page_family->family_type == MM_PAGE_FAMILY_OBJECT_CACHE)
+            mm_cache_free(curr);
+        else
+            mm_free_blocks(curr);
+        curr = next_glue ? glue_to_block_metadata(next_glue) : NULL;
+        count++;
+    }
+    return count;
+}
+
+/* Families still bound to a thread when it exits are unbound, so what other
+ * threads free afterwards is not stranded on the remote free stack */
+static void mm_owner_thread_exit(void *arg)
+{
+    vm_page_for_families_t *curr_vm_page_for_families = NULL;
+    vm_page_family_t *vm_page_family_curr = NULL;
+
+    (void)arg;
+    for(curr_vm_page_for_families = first_vm_page_for_families; curr_vm_page_for_families;
+        curr_vm_page_for_families = curr_vm_page_for_families->next)
+    {
+        ITERATE_PAGE_FAMILIES_BEGIN(curr_vm_page_for_families, vm_page_family_curr){
+            if(mm_page_family_is_owner(vm_page_family_curr))
+                mm_page_family_unbind_owner(vm_page_family_curr);
+        }ITERATE_PAGE_FAMILIES_END(curr_vm_page_for_families, vm_page_family_curr);
+    }
+}
+
+static void mm_owner_exit_key_create(void)
+{
+    if(pthread_key_create(&mm_owner_exit_key, mm_owner_thread_exit))
+        printf("Error: %s() - families of exiting threads will not be unbound\n", __FUNCTION__);
+}
+
+/* Under the family lock so that a concurrent drain of an orphaned family
+ * finishes before the new owner touches the free lists */
+void mm_page_family_bind_owner(vm_page_family_t *vm_page_family)
+{
+    pthread_mutex_lock(&vm_page_family->family_lock);
+    __atomic_store_n(&vm_page_family->owner_thread, pthread_self(), __ATOMIC_RELAXED);
+    __atomic_store_n(&vm_page_family->orphaned, MM_FALSE, __ATOMIC_RELEASE);
+    __atomic_store_n(&vm_page_family->owner_bound, MM_TRUE, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&vm_page_family->family_lock);
+
+    /* not needed when nothing is deferred, and pthread_setspecific() may
+     * allocate, which must not happen under the preload shim */
+    if(!mm_remote_free_enabled || mm_owner_exit_armed)
+        return;
+    pthread_once(&mm_owner_exit_once, mm_owner_exit_key_create);
+    if(!pthread_setspecific(mm_owner_exit_key, (void *)1))
+        mm_owner_exit_armed = MM_TRUE;
+}
+
+void mm_page_family_unbind_owner(vm_page_family_t *vm_page_family)
+{
+    pthread_mutex_lock(&vm_page_family->family_lock);
+    __atomic_store_n(&vm_page_family->orphaned, MM_TRUE, __ATOMIC_RELEASE);
+    mm_pop_remote_frees(vm_page_family);
+    pthread_mutex_unlock(&vm_page_family->family_lock);
+}
+
+/* The owner drains without a lock. Nobody allocates from an orphaned family
+ * until it is adopted, so any thread may drain it while holding the lock */
+uint32_t mm_drain_remote_frees(vm_page_family_t *vm_page_family)
+{
+    uint32_t count = 0U;
+
+    if(!__atomic_load_n(&vm_page_family->orphaned, __ATOMIC_ACQUIRE))
+        return mm_pop_remote_frees(vm_page_family);
+    pthread_mutex_lock(&vm_page_family->family_lock);
+    if(vm_page_family->orphaned)
+        count = mm_pop_remote_frees(vm_page_family);
+    pthread_mutex_unlock(&vm_page_family->family_lock);
+    return count;
+}
+
+/* Maintenance pass over the orphaned families; busy ones wait for the next pass */
+static void mm_drain_orphaned_families(void)
+{
+    vm_page_for_families_t *curr_vm_page_for_families = NULL;
+    vm_page_family_t *vm_page_family_curr = NULL;
+
+    for(curr_vm_page_for_families = first_vm_page_for_families; curr_vm_page_for_families;
+        curr_vm_page_for_families = curr_vm_page_for_families->next)
+    {
+        ITERATE_PAGE_FAMILIES_BEGIN(curr_vm_page_for_families, vm_page_family_curr){
+            if(!__atomic_load_n(&vm_page_family_curr->orphaned, __ATOMIC_ACQUIRE))
+                continue;
+            if(!__atomic_load_n(&vm_page_family_curr->remote_free_head, __ATOMIC_RELAXED) &&
+               !__atomic_load_n(&vm_page_family_curr->oob_remote_free_head, __ATOMIC_RELAXED))
+                continue;
+            if(pthread_mutex_trylock(&vm_page_family_curr->family_lock))
+                continue;
+            if(vm_page_family_curr->orphaned)
+                mm_pop_remote_frees(vm_page_family_curr);
+            pthread_mutex_unlock(&vm_page_family_curr->family_lock);
+        }ITERATE_PAGE_FAMILIES_END(curr_vm_page_for_families, vm_page_family_curr);
+    }
+}
+
+
+vm_page_family_t *mm_instantiate_new_page_family_with_limits(char *struct_name, uint32_t struct_size,
+    uint64_t soft_limit_bytes, uint64_t hard_limit_bytes)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_page_family(struct_name, struct_size);
+    if(vm_page_family)
+        mm_set_page_family_memory_limits(vm_page_family, soft_limit_bytes, hard_limit_bytes);
+    return vm_page_family;
+}
+
+void mm_set_page_family_memory_limits(vm_page_family_t *vm_page_family,
+    uint64_t soft_limit_bytes, uint64_t hard_limit_bytes)
+{
+    vm_page_family->soft_page_limit = mm_bytes_to_vm_pages(soft_limit_bytes);
+    vm_page_family->hard_page_limit = mm_bytes_to_vm_pages(hard_limit_bytes);
+}
+
+void mm_register_pressure_callback(vm_page_family_t *vm_page_family, mm_pressure_cb_t cb, void *ctx)
+{
+    vm_page_family->pressure_cb = cb;
+    vm_page_family->pressure_ctx = ctx;
+}
+
+void mm_set_global_memory_limits(uint64_t soft_limit_bytes, uint64_t hard_limit_bytes)
+{
+    mm_global_soft_page_limit = mm_bytes_to_vm_pages(soft_limit_bytes);
+    mm_global_hard_page_limit = mm_bytes_to_vm_pages(hard_limit_bytes);
+}
+
+void mm_register_global_pressure_callback(mm_pressure_cb_t cb, void *ctx)
+{
+    mm_global_pressure_cb = cb;
+    mm_global_pressure_ctx = ctx;
+}
+
+/* Hand every retired and ready vm page back to the kernel */
+static uint32_t mm_flush_vm_page_pools(void)
+{
+    vm_page_t *vm_page = NULL;
+    vm_page_t *next = NULL;
+    uint32_t count = 0U;
+
+    vm_page = __atomic_exchange_n(&mm_retired_vm_pages, NULL, __ATOMIC_ACQUIRE);
+    for(; vm_page; vm_page = next, count++){
+        next = vm_page->next;
+        __atomic_sub_fetch(&mm_retired_vm_page_count, 1U, __ATOMIC_RELAXED);
+        mm_unmap_vm_page(vm_page);
+    }
+    while((vm_page = mm_take_ready_vm_page())){
+        vm_page->units = 1U;
+        mm_unmap_vm_page(vm_page);
+        count++;
+    }
+    return count;
+}
+
+/* Give back what a family holds without needing it: warm region pages and
+ * the object cache spare from MM_PRESSURE_MEDIUM, every empty page including
+ * mm_reserve()d ones at MM_PRESSURE_CRITICAL. Called by the owner, or with
+ * the family lock held. Returns the number of vm pages released */
+static uint32_t mm_page_family_trim_locked(vm_page_family_t *vm_page_family)
+{
+    mm_pressure_level_t level = __atomic_load_n(&mm_trim_level, __ATOMIC_RELAXED);
+    vm_page_t *vm_page = NULL;
+    vm_page_t *next = NULL;
+    uint32_t page_index = 0U;
+    uint32_t n_pages = 0U;
+    uint32_t released = 0U;
+
+    __atomic_store_n(&vm_page_family->trim_epoch, __atomic_load_n(&mm_trim_epoch, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELAXED);
+    mm_pop_remote_frees(vm_page_family);
+
+    switch(vm_page_family->family_type){
+        case MM_PAGE_FAMILY_REGION:
+            while((vm_page = vm_page_family->region_free_pages)){
+                vm_page_family->region_free_pages = vm_page->next;
+                vm_page_family->region_free_page_count--;
+                vm_page_family->page_count--;
+                vm_page->page_family = NULL;
+                mm_release_vm_page(vm_page);
+                released++;
+            }
+            break;
+        case MM_PAGE_FAMILY_OBJECT_CACHE:
+            for(vm_page = vm_page_family->first_page; vm_page; vm_page = next){
+                next = vm_page->next;
+                if(vm_page->live_objects)
+                    continue;
+                if(level < MM_PRESSURE_CRITICAL && vm_page != vm_page_family->cache_spare_page)
+                    continue;
+                if(vm_page == vm_page_family->cache_spare_page)
+                    vm_page_family->cache_spare_page = NULL;
+                mm_cache_release_vm_page(vm_page);
+                released++;
+            }
+            break;
+        case MM_PAGE_FAMILY_SHARDED:
+            for(page_index = 0U; page_index < vm_page_family->shard_count; page_index++){
+                pthread_mutex_lock(&vm_page_family->shards[page_index]->family_lock);
+                released += mm_page_family_trim_locked(vm_page_family->shards[page_index]);
+                pthread_mutex_unlock(&vm_page_family->shards[page_index]->family_lock);
+            }
+            break;
+        case MM_PAGE_FAMILY_OUT_OF_BAND:
+            if(level < MM_PRESSURE_CRITICAL)
+                break;
+            n_pages = __atomic_load_n(&mm_oob_next_page, __ATOMIC_ACQUIRE);
+            for(page_index = 0U; page_index < n_pages; page_index++){
+                if(mm_oob_page_meta[page_index].page_family != vm_page_family ||
+                    mm_oob_page_meta[page_index].live_objects)
+                    continue;
+                mm_oob_remove_page(vm_page_family, page_index);
+                released++;
+            }
+            break;
+        default:
+            if(level < MM_PRESSURE_CRITICAL)
+                break;
+            for(vm_page = vm_page_family->first_page; vm_page; vm_page = next){
+                next = vm_page->next;
+                if(!mm_is_vm_page_empty(vm_page))
+                    continue;
+                glthread_list_remove(&vm_page_family->free_block_priority_list_head,
+                                     &vm_page->block_meta_data.priority_list_glue);
+                mm_vm_page_delete_and_free(vm_page);
+                released++;
+            }
+            break;
+    }
+    return released;
+}
+
+/* Nobody allocates from it without the family lock: never bound (regions,
+ * families only reserved so far) or orphaned */
+static inline vm_bool_t mm_page_family_is_unowned(vm_page_family_t *vm_page_family)
+{
+    return !__atomic_load_n(&vm_page_family->owner_bound, __ATOMIC_ACQUIRE) ||
+           __atomic_load_n(&vm_page_family->orphaned, __ATOMIC_ACQUIRE);
+}
+
+uint32_t mm_page_family_trim(vm_page_family_t *vm_page_family)
+{
+    uint32_t released = 0U;
+
+    /* shards are locked one by one inside */
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_SHARDED || mm_page_family_is_owner(vm_page_family))
+        return mm_page_family_trim_locked(vm_page_family);
+    pthread_mutex_lock(&vm_page_family->family_lock);
+    if(vm_page_family->shard_parent || mm_page_family_is_unowned(vm_page_family))
+        released = mm_page_family_trim_locked(vm_page_family);
+    pthread_mutex_unlock(&vm_page_family->family_lock);
+    return released;
+}
+
+/* After a trim request, the families no live thread allocates from are
+ * trimmed here rather than on an xcalloc() that may never come. Busy ones,
+ * and families with a live owner, are left to their next xcalloc() */
+static uint32_t mm_trim_unowned_families(void)
+{
+    vm_page_for_families_t *curr_vm_page_for_families = NULL;
+    vm_page_family_t *vm_page_family_curr = NULL;
+    uint32_t trim_epoch = __atomic_load_n(&mm_trim_epoch, __ATOMIC_ACQUIRE);
+    uint32_t released = 0U;
+
+    for(curr_vm_page_for_families = first_vm_page_for_families; curr_vm_page_for_families;
+        curr_vm_page_for_families = curr_vm_page_for_families->next)
+    {
+        ITERATE_PAGE_FAMILIES_BEGIN(curr_vm_page_for_families, vm_page_family_curr){
+            /* a sharded family is the sum of its shards, which are visited too */
+            if(vm_page_family_curr->family_type == MM_PAGE_FAMILY_SHARDED)
+                continue;
+            if(__atomic_load_n(&vm_page_family_curr->trim_epoch, __ATOMIC_RELAXED) == trim_epoch)
+                continue;
+            if(!vm_page_family_curr->shard_parent && !mm_page_family_is_unowned(vm_page_family_curr))
+                continue;
+            if(pthread_mutex_trylock(&vm_page_family_curr->family_lock))
+                continue;
+            if(vm_page_family_curr->shard_parent || mm_page_family_is_unowned(vm_page_family_curr))
+                released += mm_page_family_trim_locked(vm_page_family_curr);
+            pthread_mutex_unlock(&vm_page_family_curr->family_lock);
+        }ITERATE_PAGE_FAMILIES_END(curr_vm_page_for_families, vm_page_family_curr);
+    }
+    return released;
+}
+
+vm_bool_t mm_pressure_monitor_configure(char *cgroup_dir, char *psi_path)
+{
+    pthread_mutex_lock(&mm_pressure_mutex);
+    mm_pressure_cgroup_dir[0] = '\0';
+    mm_pressure_psi_path[0] = '\0';
+    if(cgroup_dir && snprintf(mm_pressure_cgroup_dir, sizeof(mm_pressure_cgroup_dir), "%s", cgroup_dir) >=
+        (int)sizeof(mm_pressure_cgroup_dir)){
+        mm_pressure_cgroup_dir[0] = '\0';
+        pthread_mutex_unlock(&mm_pressure_mutex);
+        printf("Error: %s() - cgroup path too long\n", __FUNCTION__);
+        return MM_FALSE;
+    }
+    if(psi_path && snprintf(mm_pressure_psi_path, sizeof(mm_pressure_psi_path), "%s", psi_path) >=
+        (int)sizeof(mm_pressure_psi_path)){
+        mm_pressure_cgroup_dir[0] = '\0';
+        mm_pressure_psi_path[0] = '\0';
+        pthread_mutex_unlock(&mm_pressure_mutex);
+        printf("Error: %s() - PSI path too long\n", __FUNCTION__);
+        return MM_FALSE;
+    }
+    mm_pressure_last_high_events = UINT64_MAX;
+    mm_pressure_last_max_events = UINT64_MAX;
+    __atomic_store_n(&mm_pressure_monitor_enabled,
+                     (cgroup_dir || psi_path) ? MM_TRUE : MM_FALSE, __ATOMIC_RELEASE);
+    pthread_mutex_unlock(&mm_pressure_mutex);
+    return MM_TRUE;
+}
+
+vm_bool_t mm_register_shrink_callback(mm_shrink_cb_t cb, void *ctx)
+{
+    pthread_mutex_lock(&mm_pressure_mutex);
+    if(mm_shrink_cb_count == MM_MAX_SHRINK_CALLBACKS){
+        pthread_mutex_unlock(&mm_pressure_mutex);
+        printf("Error: %s() - too many shrink callbacks\n", __FUNCTION__);
+        return MM_FALSE;
+    }
+    mm_shrink_cbs[mm_shrink_cb_count] = cb;
+    mm_shrink_ctxs[mm_shrink_cb_count] = ctx;
+    mm_shrink_cb_count++;
+    pthread_mutex_unlock(&mm_pressure_mutex);
+    return MM_TRUE;
+}
+
+/* Plain read(2), no stdio: this runs underneath malloc() in the preload shim */
+static vm_bool_t mm_read_small_file(char *path, char *buf, size_t size)
+{
+    ssize_t n = 0;
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+
+    if(fd < 0)
+        return MM_FALSE;
+    n = read(fd, buf, size - 1);
+    close(fd);
+    if(n < 0)
+        return MM_FALSE;
+    buf[n] = '\0';
+    return MM_TRUE;
+}
+
+/* Value of a "key value" line, as in memory.events */
+static vm_bool_t mm_parse_keyed_u64(char *buf, char *key, uint64_t *value)
+{
+    size_t key_len = strlen(key);
+    char *line = buf;
+
+    while(line && *line){
+        if(!strncmp(line, key, key_len) && line[key_len] == ' '){
+            *value = strtoull(line + key_len + 1, NULL, 10);
+            return MM_TRUE;
+        }
+        line = strchr(line, '\n');
+        if(line)
+            line++;
+    }
+    return MM_FALSE;
+}
+
+/* avg10 of the "some" or "full" line of a PSI file */
+static double mm_parse_psi_avg10(char *buf, char *kind)
+{
+    char *line = strstr(buf, kind);
+    char *avg10 = line ? strstr(line, "avg10=") : NULL;
+
+    return avg10 ? strtod(avg10 + strlen("avg10="), NULL) : 0.0;
+}
+
+static mm_pressure_level_t mm_cgroup_pressure_level(void)
+{
+    mm_pressure_level_t level = MM_PRESSURE_NONE;
+    char path[MM_PRESSURE_PATH_MAX + 32];
+    char buf[512];
+    uint64_t current = 0U;
+    uint64_t high = UINT64_MAX;
+    uint64_t high_events = 0U;
+    uint64_t max_events = 0U;
+    uint64_t oom_events = 0U;
+
+    snprintf(path, sizeof(path), "%s/memory.current", mm_pressure_cgroup_dir);
+    if(mm_read_small_file(path, buf, sizeof(buf)))
+        current = strtoull(buf, NULL, 10);
+    snprintf(path, sizeof(path), "%s/memory.high", mm_pressure_cgroup_dir);
+    if(mm_read_small_file(path, buf, sizeof(buf)) && strncmp(buf, "max", 3))
+        high = strtoull(buf, NULL, 10);
+    if(high != UINT64_MAX){
+        if(current >= high)
+            level = MM_PRESSURE_MEDIUM;
+        else if(current >= high / 100U * MM_PRESSURE_HIGH_WATERMARK_PCT)
+            level = MM_PRESSURE_LOW;
+    }
+
+    /* counters only ever grow, what matters is whether they moved since the last poll */
+    snprintf(path, sizeof(path), "%s/memory.events", mm_pressure_cgroup_dir);
+    if(mm_read_small_file(path, buf, sizeof(buf))){
+        mm_parse_keyed_u64(buf, "high", &high_events);
+        mm_parse_keyed_u64(buf, "max", &max_events);
+        mm_parse_keyed_u64(buf, "oom", &oom_events);
+        max_events += oom_events;
+        if(mm_pressure_last_high_events != UINT64_MAX && high_events > mm_pressure_last_high_events &&
+            level < MM_PRESSURE_MEDIUM)
+            level = MM_PRESSURE_MEDIUM;
+        if(mm_pressure_last_max_events != UINT64_MAX && max_events > mm_pressure_last_max_events)
+            level = MM_PRESSURE_CRITICAL;
+        mm_pressure_last_high_events = high_events;
+        mm_pressure_last_max_events = max_events;
+    }
+    return level;
+}
+
+static mm_pressure_level_t mm_psi_pressure_level(void)
+{
+    char buf[512];
+    double some = 0.0;
+    double full = 0.0;
+
+    if(!mm_read_small_file(mm_pressure_psi_path, buf, sizeof(buf)))
+        return MM_PRESSURE_NONE;
+    some = mm_parse_psi_avg10(buf, "some");
+    full = mm_parse_psi_avg10(buf, "full");
+    if(full >= MM_PSI_FULL_CRITICAL)
+        return MM_PRESSURE_CRITICAL;
+    if(some >= MM_PSI_SOME_MEDIUM || full > 0.0)
+        return MM_PRESSURE_MEDIUM;
+    if(some >= MM_PSI_SOME_LOW)
+        return MM_PRESSURE_LOW;
+    return MM_PRESSURE_NONE;
+}
+
+/* Read the configured signals and reclaim by severity:
+ *  LOW      - retired and prefaulted vm pages go back to the kernel,
+ *  MEDIUM   - families trim their caches: right here when no live thread
+ *             owns them, otherwise on their owner's next xcalloc(); shrink
+ *             callbacks run,
+ *  CRITICAL - families also release empty reserved pages.
+ * Called from the maintenance thread every pass, or by hand */
+mm_pressure_level_t mm_pressure_poll(void)
+{
+    mm_pressure_level_t level = MM_PRESSURE_NONE;
+    mm_pressure_level_t psi_level = MM_PRESSURE_NONE;
+    uint32_t i = 0U;
+
+    if(!__atomic_load_n(&mm_pressure_monitor_enabled, __ATOMIC_ACQUIRE))
+        return MM_PRESSURE_NONE;
+    /* somebody else is polling right now, go with what they saw last */
+    if(pthread_mutex_trylock(&mm_pressure_mutex))
+        return __atomic_load_n(&mm_pressure_level, __ATOMIC_RELAXED);
+
+    if(mm_pressure_cgroup_dir[0])
+        level = mm_cgroup_pressure_level();
+    if(mm_pressure_psi_path[0])
+        psi_level = mm_psi_pressure_level();
+    if(psi_level > level)
+        level = psi_level;
+    __atomic_store_n(&mm_pressure_level, level, __ATOMIC_RELAXED);
+
+    if(level >= MM_PRESSURE_LOW)
+        mm_flush_vm_page_pools();
+    if(level >= MM_PRESSURE_MEDIUM){
+        __atomic_store_n(&mm_trim_level, level, __ATOMIC_RELAXED);
+        __atomic_add_fetch(&mm_trim_epoch, 1U, __ATOMIC_RELEASE);
+        mm_trim_unowned_families();
+        for(i = 0U; i < mm_shrink_cb_count; i++)
+            mm_shrink_cbs[i](level, mm_shrink_ctxs[i]);
+    }
+    pthread_mutex_unlock(&mm_pressure_mutex);
+    return level;
+}
+
+static void mm_collect_stats(mm_stats_t *stats, uint32_t vm_page_alloc_rate, uint64_t maintenance_passes)
+{
+    stats->page_families = mm_next_family_id;
+    stats->total_vm_pages = __atomic_load_n(&mm_total_page_count, __ATOMIC_RELAXED);
+    stats->ready_vm_pages = __atomic_load_n(&mm_ready_vm_page_count, __ATOMIC_RELAXED);
+    stats->retired_vm_pages = __atomic_load_n(&mm_retired_vm_page_count, __ATOMIC_RELAXED);
+    stats->vm_pages_allocated = __atomic_load_n(&mm_vm_pages_allocated, __ATOMIC_RELAXED);
+    stats->vm_pages_returned = __atomic_load_n(&mm_vm_pages_returned, __ATOMIC_RELAXED);
+    stats->vm_page_alloc_rate = vm_page_alloc_rate;
+    stats->maintenance_passes = maintenance_passes;
+    stats->pressure_level = __atomic_load_n(&mm_pressure_level, __ATOMIC_RELAXED);
+}
+
+/* One housekeeping pass:
+ *  - retired pages refill the ready list or go back to the kernel,
+ *  - the ready list is sized to the single page allocation rate of the last
+ *    period, prefaulting new pages while families are growing and trimming the
+ *    surplus once they stop,
+ *  - the statistics snapshot is refreshed.
+ * Block coalescing stays with each family's owner thread, which is the only
+ * one allowed to touch its free block list; it is batched through the remote
+ * free queues already.
+ */
+static void mm_maintenance_sample_single_vm_pages(void)
+{
+    mm_maintenance_last_single_vm_pages = __atomic_load_n(&mm_single_vm_pages_allocated, __ATOMIC_RELAXED);
+    mm_maintenance_sampled = MM_TRUE;
+}
+
+void mm_maintenance_run_once(void)
+{
+    uint64_t single_vm_pages_allocated = 0U;
+    uint32_t target = 0U;
+    vm_page_t *vm_page = NULL;
+    vm_page_t *next = NULL;
+    mm_stats_t stats;
+
+    pthread_mutex_lock(&mm_maintenance_pass_mutex);
+    if(!mm_maintenance_sampled)
+        mm_maintenance_sample_single_vm_pages();
+    single_vm_pages_allocated = __atomic_load_n(&mm_single_vm_pages_allocated, __ATOMIC_RELAXED);
+    target = (uint32_t)(single_vm_pages_allocated - mm_maintenance_last_single_vm_pages);
+    mm_maintenance_last_single_vm_pages = single_vm_pages_allocated;
+    if(target > MM_MAX_READY_VM_PAGES)
+        target = MM_MAX_READY_VM_PAGES;
+    /* no prefaulting while memory is tight */
+    if(mm_pressure_poll() >= MM_PRESSURE_LOW)
+        target = 0U;
+    mm_drain_orphaned_families();
+
+    vm_page = __atomic_exchange_n(&mm_retired_vm_pages, NULL, __ATOMIC_ACQUIRE);
+    for(; vm_page; vm_page = next){
+        next = vm_page->next;
+        __atomic_sub_fetch(&mm_retired_vm_page_count, 1U, __ATOMIC_RELAXED);
+        if(vm_page->units == 1U && mm_ready_vm_page_count < target){
+            memset(vm_page, 0, SYSTEM_PAGE_SIZE);
+            mm_put_ready_vm_page(vm_page);
+            continue;
+        }
+        mm_unmap_vm_page(vm_page);
+    }
+
+    while(mm_ready_vm_page_count < target && mm_global_reserve_pages(1U)){
+        vm_page = (vm_page_t *)mm_get_new_vm_page_from_kernel(1, MM_FALSE);
+        if(!vm_page){
+            mm_global_unreserve_pages(1U);
+            break;
+        }
+        vm_page->units = 1U;
+        mm_put_ready_vm_page(vm_page);
+    }
+    while(mm_ready_vm_page_count > target && (vm_page = mm_take_ready_vm_page())){
+        vm_page->units = 1U;
+        mm_unmap_vm_page(vm_page);
+    }
+
+    mm_collect_stats(&stats, target, ++mm_maintenance_passes);
+    pthread_mutex_lock(&mm_maintenance_mutex);
+    mm_stats_snapshot = stats;
+    pthread_mutex_unlock(&mm_maintenance_mutex);
+    pthread_mutex_unlock(&mm_maintenance_pass_mutex);
+}
+
+static void *mm_maintenance_thread_fn(void *arg)
+{
+    struct timespec deadline;
+
+    (void)arg;
+    pthread_mutex_lock(&mm_maintenance_mutex);
+    while(!mm_maintenance_stopping){
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += mm_maintenance_period_ms / 1000U;
+        deadline.tv_nsec += (long)(mm_maintenance_period_ms % 1000U) * 1000000L;
+        if(deadline.tv_nsec >= 1000000000L){
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        pthread_cond_timedwait(&mm_maintenance_cond, &mm_maintenance_mutex, &deadline);
+        if(mm_maintenance_stopping)
+            break;
+        pthread_mutex_unlock(&mm_maintenance_mutex);
+        mm_maintenance_run_once();
+        pthread_mutex_lock(&mm_maintenance_mutex);
+    }
+    pthread_mutex_unlock(&mm_maintenance_mutex);
+    return NULL;
+}
+
+vm_bool_t mm_maintenance_start(uint32_t period_ms)
+{
+    if(mm_maintenance_running){
+        printf("Error: %s() - maintenance thread already running\n", __FUNCTION__);
+        return MM_FALSE;
+    }
+    mm_maintenance_period_ms = period_ms ? period_ms : 1U;
+    mm_maintenance_stopping = MM_FALSE;
+    /* the first period's rate is measured from here */
+    pthread_mutex_lock(&mm_maintenance_pass_mutex);
+    mm_maintenance_sample_single_vm_pages();
+    pthread_mutex_unlock(&mm_maintenance_pass_mutex);
+    if(pthread_create(&mm_maintenance_thread, NULL, mm_maintenance_thread_fn, NULL)){
+        printf("Error: %s() - could not create maintenance thread\n", __FUNCTION__);
+        return MM_FALSE;
+    }
+    __atomic_store_n(&mm_maintenance_running, MM_TRUE, __ATOMIC_RELEASE);
+    return MM_TRUE;
+}
+
+/* Joins the thread, then unmaps whatever is still retired or ready. Pages
+ * are no longer retired once the flag is clear, but a release that saw it set
+ * may still be pushing; it is waited for so nothing lands after the flush */
+void mm_maintenance_stop(void)
+{
+    if(!mm_maintenance_running)
+        return;
+    __atomic_store_n(&mm_maintenance_running, MM_FALSE, __ATOMIC_SEQ_CST);
+    pthread_mutex_lock(&mm_maintenance_mutex);
+    mm_maintenance_stopping = MM_TRUE;
+    pthread_cond_signal(&mm_maintenance_cond);
+    pthread_mutex_unlock(&mm_maintenance_mutex);
+    pthread_join(mm_maintenance_thread, NULL);
+    while(__atomic_load_n(&mm_retiring_threads, __ATOMIC_SEQ_CST))
+        sched_yield();
+    mm_flush_vm_page_pools();
+}
+
+void mm_get_stats(mm_stats_t *stats)
+{
+    if(!__atomic_load_n(&mm_maintenance_running, __ATOMIC_ACQUIRE)){
+        mm_collect_stats(stats, 0U, 0U);
+        return;
+    }
+    pthread_mutex_lock(&mm_maintenance_mutex);
+    *stats = mm_stats_snapshot;
+    pthread_mutex_unlock(&mm_maintenance_mutex);
+}
+
+uint32_t mm_get_total_vm_page_count(void)
+{
+    return __atomic_load_n(&mm_total_page_count, __ATOMIC_RELAXED);
+}
+
+vm_page_family_t *mm_instantiate_new_region_family(char *struct_name, uint32_t struct_size,
+    uint32_t warm_pages)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_page_family(struct_name, struct_size);
+    if(!vm_page_family)
+        return NULL;
+    vm_page_family->family_type = MM_PAGE_FAMILY_REGION;
+    vm_page_family->region_warm_pages = warm_pages;
+    return vm_page_family;
+}
+
+vm_page_family_t *mm_instantiate_new_cache_family(char *struct_name, uint32_t struct_size,
+    mm_object_ctor_t ctor, mm_object_dtor_t dtor)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_page_family(struct_name, struct_size);
+    if(!vm_page_family)
+        return NULL;
+    vm_page_family->family_type = MM_PAGE_FAMILY_OBJECT_CACHE;
+    vm_page_family->object_ctor = ctor;
+    vm_page_family->object_dtor = dtor;
+    return vm_page_family;
+}
+
+vm_page_family_t *mm_instantiate_new_oob_family(char *struct_name, uint32_t struct_size)
+{
+    vm_page_family_t *vm_page_family = NULL;
+    uint32_t slot_size = (struct_size + MM_MALLOC_ALIGNMENT - 1U) & ~(MM_MALLOC_ALIGNMENT - 1U);
+
+    if(!slot_size)
+        slot_size = MM_MALLOC_ALIGNMENT;
+    if(slot_size > SYSTEM_PAGE_SIZE){
+        printf("Error: %s() - Size of structure %s exceeds system page size\n", __FUNCTION__, struct_name);
+        return NULL;
+    }
+    if(!mm_oob_init())
+        return NULL;
+    vm_page_family = mm_instantiate_new_page_family(struct_name, struct_size);
+    if(!vm_page_family)
+        return NULL;
+    vm_page_family->family_type = MM_PAGE_FAMILY_OUT_OF_BAND;
+    vm_page_family->oob_slot_size = slot_size;
+    vm_page_family->page_span = 1U;
+    return vm_page_family;
+}
+
+vm_page_family_t *mm_instantiate_new_sharded_family(char *struct_name, uint32_t struct_size,
+    uint32_t shard_count)
+{
+    char shard_name[MM_MAX_STRUCT_NAME];
+    vm_page_family_t *vm_page_family = NULL;
+    vm_page_family_t **shards = NULL;
+    long n_cpus = sysconf(_SC_NPROCESSORS_CONF);
+    uint32_t i = 0U;
+
+    if(!shard_count)
+        shard_count = n_cpus < 1 ? 1U : (uint32_t)n_cpus;
+
+    if(shard_count > MM_MAX_SHARDS)
+        shard_count = MM_MAX_SHARDS;
+    /* room for the ".<cpu>" suffix of the shard names */
+    if(strlen(struct_name) + 4U >= MM_MAX_STRUCT_NAME){
+        printf("Error: %s() - structure name %s too long for a sharded family\n", __FUNCTION__, struct_name);
+        return NULL;
+    }
+    shards = (vm_page_family_t **)mm_get_new_vm_page_from_kernel(
+                (int)mm_bytes_to_vm_pages(shard_count * sizeof(vm_page_family_t *)), MM_FALSE);
+    if(!shards)
+        return NULL;
+    vm_page_family = mm_instantiate_new_page_family(struct_name, struct_size);
+    if(!vm_page_family){
+        mm_return_vm_page_to_kernel(shards, (int)mm_bytes_to_vm_pages(shard_count * sizeof(vm_page_family_t *)));
+        return NULL;
+    }
+    for(i = 0U; i < shard_count; i++){
+        shards[i] = mm_new_page_family_slot();
+        if(!shards[i])
+            break;
+        snprintf(shard_name, sizeof(shard_name), "%s.%u", struct_name, i);
+        mm_init_page_family(shards[i], shard_name, struct_size);
+        shards[i]->shard_parent = vm_page_family;
+    }
+    if(!i){
+        printf("Error: %s() - no shards for %s, it stays a plain page family\n", __FUNCTION__, struct_name);
+        mm_return_vm_page_to_kernel(shards, (int)mm_bytes_to_vm_pages(shard_count * sizeof(vm_page_family_t *)));
+        return vm_page_family;
+    }
+    /* fewer shards than CPUs only means CPUs share them */
+    vm_page_family->family_type = MM_PAGE_FAMILY_SHARDED;
+    vm_page_family->shards = shards;
+    vm_page_family->shard_count = i;
+    return vm_page_family;
+}
+
+/* Called by the owner, or with the family lock held */
+static uint32_t mm_reserve_locked(vm_page_family_t *vm_page_family, uint32_t n_objects)
+{
+    uint32_t objects_per_page = mm_page_span_objects(vm_page_family->struct_size, vm_page_family->page_span);
+    uint32_t n_pages = (n_objects + objects_per_page - 1U) / objects_per_page;
+    uint32_t held_pages = 0U;
+    vm_page_t *vm_page = NULL;
+
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_REGION){
+        if(vm_page_family->region_warm_pages < n_pages)
+            vm_page_family->region_warm_pages = n_pages;
+        while(vm_page_family->region_free_page_count < n_pages){
+            vm_page = mm_allocate_vm_page_populate(vm_page_family, MM_TRUE);
+            if(!vm_page)
+                break;
+            /* straight from the page list onto the warm list */
+            vm_page_family->first_page = vm_page->next;
+            if(vm_page->next)
+                vm_page->next->prev = NULL;
+            vm_page->next = vm_page_family->region_free_pages;
+            vm_page_family->region_free_pages = vm_page;
+            vm_page_family->region_free_page_count++;
+        }
+        return vm_page_family->region_free_page_count;
+    }
+
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_OUT_OF_BAND){
+        objects_per_page = mm_oob_slot_count(vm_page_family);
+        n_pages = (n_objects + objects_per_page - 1U) / objects_per_page;
+    }
+    if(vm_page_family->reserved_page_count < n_pages)
+        vm_page_family->reserved_page_count = n_pages;
+    while(vm_page_family->page_count < n_pages){
+        if(vm_page_family->family_type == MM_PAGE_FAMILY_OUT_OF_BAND ?
+            mm_oob_add_page(vm_page_family, MM_TRUE) == MM_OOB_NO_PAGE :
+            !mm_allocate_vm_page_populate(vm_page_family, MM_TRUE))
+            break;
+    }
+    held_pages = vm_page_family->page_count;
+    return held_pages < n_pages ? held_pages : n_pages;
+}
+
+/* Enough prefaulted pages for n_objects single unit allocations. They are
+ * never handed back while the family is at or under the reservation; region
+ * families keep them as warm pages. Call it before other threads use the
+ * family, or from its owner */
+uint32_t mm_reserve(vm_page_family_t *vm_page_family, uint32_t n_objects)
+{
+    uint32_t held_pages = 0U;
+    uint32_t i = 0U;
+
+    /* every CPU starts out with its share */
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_SHARDED){
+        n_objects = (n_objects + vm_page_family->shard_count - 1U) / vm_page_family->shard_count;
+        for(i = 0U; i < vm_page_family->shard_count; i++){
+            pthread_mutex_lock(&vm_page_family->shards[i]->family_lock);
+            held_pages += mm_reserve_locked(vm_page_family->shards[i], n_objects);
+            pthread_mutex_unlock(&vm_page_family->shards[i]->family_lock);
+        }
+        return held_pages;
+    }
+    if(mm_page_family_is_owner(vm_page_family))
+        return mm_reserve_locked(vm_page_family, n_objects);
+    /* not allocated from yet, or orphaned: mm_pressure_poll() may be trimming it */
+    pthread_mutex_lock(&vm_page_family->family_lock);
+    held_pages = mm_reserve_locked(vm_page_family, n_objects);
+    pthread_mutex_unlock(&vm_page_family->family_lock);
+    return held_pages;
+}
+
+void mm_region_set_warm_pages(vm_page_family_t *vm_page_family, uint32_t warm_pages)
+{
+    vm_page_family->region_warm_pages = warm_pages;
+}
+
+/* Drop every object of a region family. While the family holds no more than its
+ * warm pages, the whole page list is spliced onto the warm list in O(1); any
+ * surplus pages are handed back to the kernel.
+ */
+void mm_region_reset(vm_page_family_t *vm_page_family)
+{
+    vm_page_t *vm_page = NULL;
+
+    assert(vm_page_family->family_type == MM_PAGE_FAMILY_REGION);
+    MM_TRACE(MM_TRACE_OP_RESET, vm_page_family, 0U, NULL);
+
+    pthread_mutex_lock(&vm_page_family->family_lock);
+    if(vm_page_family->first_page &&
+        vm_page_family->page_count <= vm_page_family->region_warm_pages){
+        vm_page_family->region_tail_page->next = vm_page_family->region_free_pages;
+        vm_page_family->region_free_pages = vm_page_family->first_page;
+        vm_page_family->region_free_page_count = vm_page_family->page_count;
+        vm_page_family->first_page = NULL;
+    }
+
+    while((vm_page = vm_page_family->first_page)){
+        if(vm_page_family->region_free_page_count < vm_page_family->region_warm_pages){
+            vm_page_family->first_page = vm_page->next;
+            if(vm_page->next)
+                vm_page->next->prev = NULL;
+            vm_page->next = vm_page_family->region_free_pages;
+            vm_page_family->region_free_pages = vm_page;
+            vm_page_family->region_free_page_count++;
+            continue;
+        }
+        mm_vm_page_delete_and_free(vm_page);
+    }
+    /* mm_region_set_warm_pages() may have lowered the count since the last reset */
+    while(vm_page_family->region_free_page_count > vm_page_family->region_warm_pages){
+        vm_page = vm_page_family->region_free_pages;
+        vm_page_family->region_free_pages = vm_page->next;
+        vm_page_family->region_free_page_count--;
+        vm_page_family->page_count--;
+        vm_page->page_family = NULL;
+        mm_release_vm_page(vm_page);
+    }
+
+    vm_page_family->region_cursor = NULL;
+    vm_page_family->region_end = NULL;
+    vm_page_family->region_last_block = NULL;
+    vm_page_family->region_tail_page = NULL;
+    pthread_mutex_unlock(&vm_page_family->family_lock);
+}
+
+static int mm_vm_page_address_compare(const void *a, const void *b)
+{
+    uintptr_t page_a = (uintptr_t)*(vm_page_t * const *)a;
+    uintptr_t page_b = (uintptr_t)*(vm_page_t * const *)b;
+    return (page_a > page_b) - (page_a < page_b);
+}
+
+/* Snapshot of the family's vm pages sorted by address, in scratch vm pages */
+static vm_page_t **mm_collect_vm_pages_sorted(vm_page_family_t *vm_page_family,
+    uint32_t *page_count, uint32_t *scratch_units)
+{
+    vm_page_t **vm_pages = NULL;
+    vm_page_t *vm_page_curr = NULL;
+    uint32_t count = 0U;
+
+    *page_count = 0U;
+    *scratch_units = 0U;
+    if(!vm_page_family->page_count)
+        return NULL;
+    *scratch_units = (uint32_t)((vm_page_family->page_count * sizeof(vm_page_t *) + SYSTEM_PAGE_SIZE - 1) / SYSTEM_PAGE_SIZE);
+    vm_pages = mm_get_scratch_vm_pages((int)*scratch_units);
+    if(!vm_pages)
+        return NULL;
+
+    ITERATE_VM_PAGE_BEGIN(vm_page_family, vm_page_curr){
+        vm_pages[count++] = vm_page_curr;
+    }ITERATE_VM_PAGE_END(vm_page_family, vm_page_curr);
+
+    qsort(vm_pages, count, sizeof(vm_page_t *), mm_vm_page_address_compare);
+    *page_count = count;
+    return vm_pages;
+}
+
+static uint64_t mm_for_each_object_on_vm_page(vm_page_t *vm_page, vm_page_t *next_vm_page,
+    mm_object_cb_t cb, void *ctx)
+{
+    uint32_t struct_size = vm_page->page_family->struct_size;
+    block_meta_data_t *curr = &vm_page->block_meta_data;
+    block_meta_data_t *next = NULL;
+    uint64_t count = 0U;
+    char *object = NULL;
+    char *block_end = NULL;
+
+    if(next_vm_page)
+        __builtin_prefetch(&next_vm_page->block_meta_data);
+
+    for(; curr; curr = next){
+        next = NEXT_META_BLOCK(curr);
+        if(next)
+            __builtin_prefetch(next);
+        /* free, or freed by another thread and not drained yet */
+        if(curr->is_free != MM_FALSE)
+            continue;
+        /* a block carries as many objects as the units it was allocated with */
+        block_end = (char *)(curr + 1) + curr->block_size;
+        for(object = (char *)(curr + 1); object + struct_size <= block_end; object += struct_size){
+            cb(object, ctx);
+            count++;
+        }
+    }
+    return count;
+}
+
+typedef struct mm_object_snapshot_{
+    void **objects;
+    uint64_t count;
+}mm_object_snapshot_t;
+
+static void mm_object_count_cb(void *object, void *ctx)
+{
+    (void)object;
+    (void)ctx;
+}
+
+static void mm_object_snapshot_cb(void *object, void *ctx)
+{
+    mm_object_snapshot_t *snapshot = (mm_object_snapshot_t *)ctx;
+
+    snapshot->objects[snapshot->count++] = object;
+}
+
+/* A shard's live objects, collected under its lock so the visitor can run
+ * without it: it may allocate from or free to the sharded family itself */
+static void **mm_shard_snapshot_objects(vm_page_family_t *shard, uint64_t *n_objects, uint32_t *scratch_units)
+{
+    mm_object_snapshot_t snapshot = {NULL, 0U};
+    uint64_t live_objects = 0U;
+
+    *scratch_units = 0U;
+    pthread_mutex_lock(&shard->family_lock);
+    live_objects = mm_for_each_object(shard, mm_object_count_cb, NULL);
+    if(live_objects){
+        *scratch_units = mm_bytes_to_vm_pages(live_objects * sizeof(void *));
+        snapshot.objects = (void **)mm_get_scratch_vm_pages((int)*scratch_units);
+        if(snapshot.objects)
+            mm_for_each_object(shard, mm_object_snapshot_cb, &snapshot);
+    }
+    pthread_mutex_unlock(&shard->family_lock);
+    *n_objects = snapshot.count;
+    return snapshot.objects;
+}
+
+uint64_t mm_for_each_object(vm_page_family_t *vm_page_family, mm_object_cb_t cb, void *ctx)
+{
+    vm_page_t **vm_pages = NULL;
+    void **objects = NULL;
+    uint64_t n_objects = 0U;
+    uint64_t j = 0U;
+    uint32_t page_count = 0U;
+    uint32_t scratch_units = 0U;
+    uint32_t i = 0U;
+    uint64_t count = 0U;
+
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_OUT_OF_BAND)
+        return mm_oob_for_each_object(vm_page_family, cb, ctx);
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_SHARDED){
+        for(i = 0U; i < vm_page_family->shard_count; i++){
+            objects = mm_shard_snapshot_objects(vm_page_family->shards[i], &n_objects, &scratch_units);
+            for(j = 0U; j < n_objects; j++)
+                cb(objects[j], ctx);
+            count += n_objects;
+            if(objects)
+                mm_return_vm_page_to_kernel(objects, scratch_units);
+        }
+        return count;
+    }
+    vm_pages = mm_collect_vm_pages_sorted(vm_page_family, &page_count, &scratch_units);
+    for(i = 0U; i < page_count; i++){
+        count += mm_for_each_object_on_vm_page(vm_pages[i],
+                    (i + 1 < page_count) ? vm_pages[i + 1] : NULL, cb, ctx);
+    }
+    if(vm_pages)
+        mm_return_vm_page_to_kernel(vm_pages, scratch_units);
+    return count;
+}
+
+typedef struct mm_for_each_worker_{
+    vm_page_t **vm_pages; /* pages to walk, or */
+    void **objects;       /* a shard's snapshot, one cb per entry */
+    uint64_t n_items;
+    uint64_t *next_index; /* shared cursor, items are handed out in chunks */
+    mm_object_cb_t cb;
+    void *ctx;
+    uint64_t count;
+}mm_for_each_worker_t;
+
+#define MM_FOR_EACH_PAGES_PER_CHUNK 8U
+#define MM_FOR_EACH_OBJECTS_PER_CHUNK 256U
+
+static void *mm_for_each_object_worker(void *arg)
+{
+    mm_for_each_worker_t *worker = (mm_for_each_worker_t *)arg;
+    uint64_t chunk = worker->vm_pages ? MM_FOR_EACH_PAGES_PER_CHUNK : MM_FOR_EACH_OBJECTS_PER_CHUNK;
+    uint64_t first = 0U;
+    uint64_t i = 0U;
+
+    while((first = __atomic_fetch_add(worker->next_index, chunk, __ATOMIC_RELAXED)) < worker->n_items){
+        for(i = first; i < first + chunk && i < worker->n_items; i++){
+            if(!worker->vm_pages){
+                worker->cb(worker->objects[i], worker->ctx);
+                worker->count++;
+                continue;
+            }
+            worker->count += mm_for_each_object_on_vm_page(worker->vm_pages[i],
+                                (i + 1 < worker->n_items) ? worker->vm_pages[i + 1] : NULL,
+                                worker->cb, worker->ctx);
+        }
+    }
+    return NULL;
+}
+
+/* Spread n_items pages (or snapshotted objects) over up to n_workers threads */
+static uint64_t mm_run_for_each_workers(vm_page_t **vm_pages, void **objects, uint64_t n_items,
+    mm_object_cb_t cb, void *ctx, uint32_t n_workers)
+{
+    mm_for_each_worker_t workers[MM_MAX_FOR_EACH_WORKERS];
+    pthread_t threads[MM_MAX_FOR_EACH_WORKERS];
+    vm_bool_t started[MM_MAX_FOR_EACH_WORKERS];
+    uint64_t next_index = 0U;
+    uint64_t count = 0U;
+    uint32_t i = 0U;
+
+    for(i = 0U; i < n_workers; i++){
+        workers[i].vm_pages = vm_pages;
+        workers[i].objects = objects;
+        workers[i].n_items = n_items;
+        workers[i].next_index = &next_index;
+        workers[i].cb = cb;
+        workers[i].ctx = ctx;
+        workers[i].count = 0U;
+        started[i] = MM_FALSE;
+    }
+    /* the calling thread is worker 0, a worker that fails to start is simply not needed */
+    for(i = 1U; i < n_workers; i++){
+        started[i] = pthread_create(&threads[i], NULL, mm_for_each_object_worker, &workers[i]) == 0 ?
+                        MM_TRUE : MM_FALSE;
+    }
+    mm_for_each_object_worker(&workers[0]);
+    count = workers[0].count;
+    for(i = 1U; i < n_workers; i++){
+        if(!started[i])
+            continue;
+        pthread_join(threads[i], NULL);
+        count += workers[i].count;
+    }
+    return count;
+}
+
+uint64_t mm_parallel_for_each_object(vm_page_family_t *vm_page_family, mm_object_cb_t cb, void *ctx,
+    uint32_t n_workers)
+{
+    vm_page_t **vm_pages = NULL;
+    void **objects = NULL;
+    uint64_t n_objects = 0U;
+    uint32_t page_count = 0U;
+    uint32_t scratch_units = 0U;
+    uint32_t i = 0U;
+    uint64_t count = 0U;
+
+    if(n_workers < 1U)
+        n_workers = 1U;
+    if(n_workers > MM_MAX_FOR_EACH_WORKERS)
+        n_workers = MM_MAX_FOR_EACH_WORKERS;
+
+    /* a table scan, not worth the threads */
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_OUT_OF_BAND)
+        return mm_oob_for_each_object(vm_page_family, cb, ctx);
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_SHARDED){
+        for(i = 0U; i < vm_page_family->shard_count; i++){
+            objects = mm_shard_snapshot_objects(vm_page_family->shards[i], &n_objects, &scratch_units);
+            if(!n_objects)
+                continue;
+            count += mm_run_for_each_workers(NULL, objects, n_objects, cb, ctx, n_workers);
+            mm_return_vm_page_to_kernel(objects, scratch_units);
+        }
+        return count;
+    }
+    vm_pages = mm_collect_vm_pages_sorted(vm_page_family, &page_count, &scratch_units);
+    if(!page_count)
+        return 0U;
+    count = mm_run_for_each_workers(vm_pages, NULL, page_count, cb, ctx, n_workers);
+    mm_return_vm_page_to_kernel(vm_pages, scratch_units);
+    return count;
+}
+
+void mm_print_block_usage(void)
+{
+    vm_page_for_families_t *vm_page_family_base_ptr = NULL;
+    vm_page_family_t *vm_page_family_curr = NULL;
+    vm_page_t *vm_page_curr = NULL;
+    block_meta_data_t *block_meta_data_curr = NULL;
+
+    uint32_t total_block_count = 0U;
+    uint32_t free_block_count = 0U;
+    uint32_t occupied_block_count = 0U;
+    uint32_t app_memory_usage = 0U;
 
     vm_page_family_base_ptr = first_vm_page_for_families;
 
     ITERATE_PAGE_FAMILIES_BEGIN(vm_page_family_base_ptr, vm_page_family_curr){
 
+        /* no vm pages on the list, the metadata table has it all */
+        if(vm_page_family_curr->family_type == MM_PAGE_FAMILY_OUT_OF_BAND)
+            mm_oob_block_usage(vm_page_family_curr, &total_block_count, &free_block_count,
+                               &occupied_block_count, &app_memory_usage);
+
+        /* other threads may be allocating from a shard */
+        if(vm_page_family_curr->shard_parent)
+            pthread_mutex_lock(&vm_page_family_curr->family_lock);
         ITERATE_VM_PAGE_BEGIN(vm_page_family_curr, vm_page_curr){
 
             ITERATE_VM_PAGE_ALL_BLOCKS_BEGIN(vm_page_curr, block_meta_data_curr){
@@ -506,8 +3153,9 @@ void mm_print_block_usage(void)
                 if(block_meta_data_curr->is_free == MM_TRUE){
                     assert(!IS_GLTHREAD_LIST_EMPTY(&block_meta_data_curr->priority_list_glue));
                 }
+                /* MM_FREE_PENDING blocks have their glue on the remote free stack */
 
-                if(block_meta_data_curr->is_free == MM_TRUE){
+                if(block_meta_data_curr->is_free != MM_FALSE){
                     free_block_count++;
                 }
                 else{
@@ -518,6 +3166,8 @@ void mm_print_block_usage(void)
             }ITERATE_VM_PAGE_ALL_BLOCKS_END(vm_page_curr, block_meta_data_curr);
 
         }ITERATE_VM_PAGE_END(vm_page_family_curr, vm_page_curr);
+        if(vm_page_family_curr->shard_parent)
+            pthread_mutex_unlock(&vm_page_family_curr->family_lock);
 
         printf("%-20s   TBC : %-4u    FBC : %-4u    OBC : %-4u AppMemUsage : %u\n",
             vm_page_family_curr->struct_name, total_block_count,
@@ -526,6 +3176,31 @@ void mm_print_block_usage(void)
     }ITERATE_PAGE_FAMILIES_END(vm_page_family_base_ptr, vm_page_family_curr);
 }
 
+void mm_print_page_family_spans(void)
+{
+    vm_page_for_families_t *curr_vm_page_for_families = NULL;
+    vm_page_family_t *vm_page_family_curr = NULL;
+    uint32_t objects = 0U;
+    uint32_t span = 0U;
+
+    printf("Page family spans:\n");
+    for(curr_vm_page_for_families = first_vm_page_for_families; curr_vm_page_for_families;
+        curr_vm_page_for_families = curr_vm_page_for_families->next)
+    {
+        ITERATE_PAGE_FAMILIES_BEGIN(curr_vm_page_for_families, vm_page_family_curr){
+
+            span = vm_page_family_curr->page_span;
+            objects = mm_page_span_objects(vm_page_family_curr->struct_size, span);
+            printf("\t%-32s size = %-5u span = %u page(s)  objects/span = %-4u  utilization = %5.1f%% (single page %5.1f%%)\n",
+                vm_page_family_curr->struct_name, vm_page_family_curr->struct_size, span, objects,
+                100.0 * objects * vm_page_family_curr->struct_size / (span * SYSTEM_PAGE_SIZE),
+                100.0 * mm_page_span_objects(vm_page_family_curr->struct_size, 1U) *
+                    vm_page_family_curr->struct_size / SYSTEM_PAGE_SIZE);
+
+        }ITERATE_PAGE_FAMILIES_END(curr_vm_page_for_families, vm_page_family_curr);
+    }
+}
+
 void mm_print_vm_page_details(vm_page_t *vm_page){
 
     printf("\t\t next = %p, prev = %p\n", vm_page->next, vm_page->prev);
@@ -538,7 +3213,8 @@ void mm_print_vm_page_details(vm_page_t *vm_page){
         printf("\t\t\t%-14p Block %-3u %s  block_size = %-6u  "
                 "offset = %-6u  prev = %-14p  next = %p\n",
                 curr,
-                j++, curr->is_free ? "F R E E D" : "ALLOCATED",
+                j++, curr->is_free == MM_FREE_PENDING ? "FREE PEND" :
+                     curr->is_free ? "F R E E D" : "ALLOCATED",
                 curr->block_size, curr->offset,
                 curr->prev_block,
                 curr->next_block);
@@ -572,7 +3248,7 @@ void mm_print_memory_usage(char *struct_name)
 
         ITERATE_VM_PAGE_BEGIN(vm_page_family_curr, vm_page_curr){
 
-            cumulative_vm_pages_claimed_from_kernel++;
+            cumulative_vm_pages_claimed_from_kernel += vm_page_curr->units;
             printf("Entry\n");
             mm_print_vm_page_details(vm_page_curr);
 
@@ -595,10 +3271,11 @@ void mm_print_vm_page_priority_queue(vm_page_family_t *vm_page_family)
 {
     glthread_t *curr = NULL;
     block_meta_data_t *curr_block = NULL;
-    ITERATE_GLTHREAD_BEGIN(&vm_page_family->free_block_priority_list_head, curr){
+    printf("%s(): %u free blocks\n", __FUNCTION__, glthread_list_count(&vm_page_family->free_block_priority_list_head));
+    ITERATE_GLTHREAD_BEGIN(&vm_page_family->free_block_priority_list_head.head, curr){
         curr_block = glue_to_block_metadata(curr);
         printf("%s(): block meta data @ %p\n", __FUNCTION__, curr_block);
         printf("\t block_size is %u\n", curr_block->block_size);
 
-    }ITERATE_GLTHREAD_END(&vm_page_family->free_block_priority_list_head, curr);
+    }ITERATE_GLTHREAD_END(&vm_page_family->free_block_priority_list_head.head, curr);
 }
\ No newline at end of file
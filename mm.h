@@ -2,19 +2,80 @@
 #define MM_H_
 
 #include <stdint.h>
+#include <pthread.h>
 #include "glueThread/glthread.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 #define MM_MAX_STRUCT_NAME  32U
 
+/* xmalloc() size classes: powers of two from 16 to 2048 bytes */
+#define MM_MALLOC_ALIGNMENT     16U
+#define MM_SIZE_CLASS_MIN_SHIFT 4U
+#define MM_SIZE_CLASS_MIN       (1U << MM_SIZE_CLASS_MIN_SHIFT)
+#define MM_SIZE_CLASS_COUNT     8U
+#define MM_SIZE_CLASS_MAX       (MM_SIZE_CLASS_MIN << (MM_SIZE_CLASS_COUNT - 1))
+
+#define MM_MAX_FOR_EACH_WORKERS 64U
+
+/* Buckets of the registry's name hash, a power of two */
+#define MM_FAMILY_NAME_HASH_BUCKETS 256U
+
+/* A family's vm pages span 1..MM_MAX_PAGE_SPAN system pages; the smallest
+ * span wasting at most 1/MM_PAGE_SPAN_TIE_DIVISOR of itself more than the
+ * least wasteful one wins */
+#define MM_MAX_PAGE_SPAN            8U
+#define MM_PAGE_SPAN_TIE_DIVISOR    32U
+
+/* Out-of-band families: data pages are cut from one reserved address range
+ * and carry no headers at all; their slot state lives in a dense table with
+ * one mm_oob_page_meta_t per page of the range */
+#define MM_OOB_ARENA_PAGES  262144U
+#define MM_OOB_MAX_SLOTS    256U
+#define MM_OOB_NO_PAGE      0xFFFFFFFFU
+
+/* Pressure monitor thresholds: share of memory.high, PSI avg10 percentages */
+#define MM_PRESSURE_PATH_MAX            256U
+#define MM_PRESSURE_HIGH_WATERMARK_PCT  90U
+#define MM_PSI_SOME_LOW                 10.0
+#define MM_PSI_SOME_MEDIUM              30.0
+#define MM_PSI_FULL_CRITICAL            10.0
+#define MM_MAX_SHRINK_CALLBACKS         16U
+
+/* Sharded families get one shard per configured CPU, up to this many */
+#define MM_MAX_SHARDS   256U
+
+/* Cap on the prefaulted pages the maintenance thread keeps ready */
+#define MM_MAX_READY_VM_PAGES   256U
+
 typedef enum{
     MM_FALSE,
     MM_TRUE
 }vm_bool_t;
 
+/* Allocation tags (tenants), counted per tag across all families. Tag 0 is
+ * the untagged default. Build with -DMM_NO_TAGS to compile accounting out */
+typedef uint32_t mm_tag_t;
+#define MM_TAG_UNTAGGED 0U
+#define MM_MAX_TAGS     256U
+
+typedef struct mm_tag_stats_{
+    uint64_t live_bytes;
+    uint64_t live_objects;
+    uint64_t vm_pages; /* system pages of the vm pages this tag caused to be mapped */
+}mm_tag_stats_t;
+
+/* is_free of a block another thread xfree()d, parked on the family's remote
+ * free stack until the owner drains it: neither allocated nor on a free list */
+#define MM_FREE_PENDING ((vm_bool_t)2)
+
 typedef struct block_meta_data_{
-    vm_bool_t is_free;
+    vm_bool_t is_free; /* MM_TRUE, MM_FALSE or MM_FREE_PENDING */
     uint32_t block_size;
     uint32_t offset; /* offset from the strt of the page */
+    mm_tag_t tag; /* fills the padding, set while allocated */
     struct block_meta_data_ *prev_block;
     struct block_meta_data_ *next_block;
     glthread_t priority_list_glue;
@@ -22,13 +83,74 @@ typedef struct block_meta_data_{
 
 GLTHREAD_TO_STRUCT(glue_to_block_metadata, block_meta_data_t, priority_list_glue);
 
+typedef enum{
+    MM_PAGE_FAMILY_GENERAL,
+    MM_PAGE_FAMILY_REGION,      /* bump allocated, freed in bulk by mm_region_reset() */
+    MM_PAGE_FAMILY_OBJECT_CACHE, /* fixed slots kept constructed across xcalloc()/xfree() */
+    MM_PAGE_FAMILY_OUT_OF_BAND, /* headerless data pages, block state in mm_oob_page_meta_t */
+    MM_PAGE_FAMILY_SHARDED      /* no pages of its own, one general family per CPU does the work */
+}vm_page_family_type_t;
+
 /* Forward declaration */
 struct vm_page_family_;
 
+typedef struct mm_stats_{
+    uint32_t page_families;
+    uint32_t total_vm_pages;     /* everything mapped, ready and retired pages included */
+    uint32_t ready_vm_pages;     /* prefaulted, waiting for a family */
+    uint32_t retired_vm_pages;   /* empty, waiting to be recycled or unmapped */
+    uint32_t vm_page_alloc_rate; /* single vm pages handed to families in the last period */
+    uint64_t vm_pages_allocated;
+    uint64_t vm_pages_returned;
+    uint64_t maintenance_passes;
+    uint32_t pressure_level; /* mm_pressure_level_t seen by the last poll */
+}mm_stats_t;
+
+/* One entry of a static registration table, see mm_register_page_families() */
+typedef struct mm_page_family_reg_{
+    char *struct_name;
+    uint32_t struct_size;
+    uint32_t reserve_objects; /* handed to mm_reserve(), 0 for none */
+    struct vm_page_family_ **page_family; /* where to store the family, may be NULL */
+}mm_page_family_reg_t;
+
+typedef struct mm_oob_page_meta_{
+    struct vm_page_family_ *page_family; /* NULL while the page is not mapped */
+    uint64_t free_slots[MM_OOB_MAX_SLOTS / 64]; /* bit set = slot free */
+    uint16_t live_objects;
+    uint16_t slot_count;
+    uint32_t next_partial; /* family's pages with free slots, or the arena's free page stack */
+    uint32_t prev_partial;
+}mm_oob_page_meta_t;
+
+/* Visitor for mm_for_each_object(), called once per live object */
+typedef void (*mm_object_cb_t)(void *object, void *ctx);
+
+/* Object cache families: ctor runs once per slot when its vm page is populated,
+ * dtor only when the vm page goes back to the kernel */
+typedef void (*mm_object_ctor_t)(void *object);
+typedef void (*mm_object_dtor_t)(void *object);
+
+typedef enum{
+    MM_PRESSURE_NONE,
+    MM_PRESSURE_LOW,
+    MM_PRESSURE_MEDIUM,
+    MM_PRESSURE_CRITICAL
+}mm_pressure_level_t;
+
+/* Application cache shrinker, run by mm_pressure_poll() from MM_PRESSURE_MEDIUM up */
+typedef void (*mm_shrink_cb_t)(mm_pressure_level_t level, void *ctx);
+
+/* Invoked when a family (or the whole process) is about to grow past its soft limit */
+typedef void (*mm_pressure_cb_t)(struct vm_page_family_ *vm_page_family, void *ctx);
+
 typedef struct vm_page_{
     struct vm_page_ *next;
     struct vm_page_ *prev;
-    struct vm_page_family_ *page_family; /* Back pointer */
+    struct vm_page_family_ *page_family; /* Back pointer, NULL for huge xmalloc() blocks */
+    uint32_t units; /* contiguous system pages in this vm page */
+    uint16_t live_objects; /* object cache families only, allocated slots */
+    uint16_t tag; /* mm_tag_t charged with this vm page */
     block_meta_data_t block_meta_data;
     char page_memory[0];
 }vm_page_t;
@@ -36,8 +158,45 @@ typedef struct vm_page_{
 typedef struct vm_page_family_{
     char struct_name[MM_MAX_STRUCT_NAME];
     uint32_t struct_size;
+    struct vm_page_family_ *name_hash_next; /* chain of the registry's name hash bucket */
     vm_page_t *first_page;
-    glthread_t free_block_priority_list_head;
+    glthread_list_t free_block_priority_list_head;
+    pthread_t owner_thread; /* only this thread allocates and coalesces */
+    vm_bool_t owner_bound;
+    vm_bool_t orphaned; /* owner unbound or exited: every free is deferred until a thread adopts it */
+    block_meta_data_t *remote_free_head; /* blocks xfree()d by other threads */
+    uint32_t page_count; /* vm pages currently held, page_span system pages each */
+    uint32_t soft_page_limit; /* 0 means no limit */
+    uint32_t hard_page_limit;
+    mm_pressure_cb_t pressure_cb;
+    void *pressure_ctx;
+    vm_page_family_type_t family_type;
+    /* region families: bump pointer into first_page */
+    char *region_cursor;
+    char *region_end;
+    block_meta_data_t *region_last_block;
+    vm_page_t *region_tail_page;
+    vm_page_t *region_free_pages; /* warm pages kept across resets */
+    uint32_t region_free_page_count;
+    uint32_t region_warm_pages;
+    uint32_t reserved_page_count; /* empty pages are kept mapped up to this many, see mm_reserve() */
+    uint32_t page_span; /* system pages per vm page, picked at registration to cut tail waste */
+    /* object cache families */
+    mm_object_ctor_t object_ctor;
+    mm_object_dtor_t object_dtor;
+    vm_page_t *cache_spare_page; /* one empty vm page kept populated */
+    /* out-of-band families */
+    uint32_t oob_slot_size;
+    uint32_t oob_first_partial; /* arena page index, MM_OOB_NO_PAGE if none */
+    void *oob_remote_free_head; /* objects xfree()d by other threads, linked through their first word */
+    uint32_t trim_epoch; /* last pressure trim request this family honoured */
+    /* sharded families: the parent lists its shards, a shard points back */
+    struct vm_page_family_ **shards;
+    uint32_t shard_count;
+    struct vm_page_family_ *shard_parent;
+    pthread_mutex_t family_lock; /* shards: in place of the owner thread; others: owner hand over */
+    uint32_t family_id; /* registration order, names the family in traces */
+    uint32_t trace_session; /* last trace session which saw this family */
 }vm_page_family_t;
 
 typedef struct vm_page_for_families_{
@@ -81,8 +240,8 @@ typedef struct vm_page_for_families_{
     vm_page_ptr->block_meta_data.is_free = MM_TRUE;
 
 /* size excluding the vm_page_t structure, including the first meta block */
-#define VM_PAGE_USABLE_SIZE \
-    (SYSTEM_PAGE_SIZE - sizeof(vm_page_t) + sizeof(block_meta_data_t))
+#define VM_PAGE_USABLE_SIZE(units) \
+    ((units) * SYSTEM_PAGE_SIZE - sizeof(vm_page_t) + sizeof(block_meta_data_t))
 
 #define ITERATE_PAGE_FAMILIES_BEGIN(vm_page_for_families_ptr, curr)                     \
 {                                                                                       \
@@ -97,7 +256,8 @@ typedef struct vm_page_for_families_{
 #define ITERATE_META_BLOCKS_BEGIN(first_meta_block, curr_meta_block)                    \
 {                                                                                       \
     for(curr_meta_block = first_meta_block;                                             \
-        curr_meta_block < (block_meta_data_t *)((char *)first_meta_block + VM_PAGE_USABLE_SIZE);   \
+        curr_meta_block < (block_meta_data_t *)((char *)first_meta_block +                \
+            VM_PAGE_USABLE_SIZE(((vm_page_t *)MM_GET_PAGE_FROM_META_BLOCK(first_meta_block))->units)); \
         curr_meta_block += (block_meta_data_t *)(curr_meta_block->block_size + sizeof(block_meta_data_t)))   \
         {                                                                               \
 
@@ -118,7 +278,8 @@ typedef struct vm_page_for_families_{
     curr_block_meta_data = &vm_page_ptr->block_meta_data;                                               \
     first_meta_block = curr_block_meta_data;                                                            \
     for(; (curr_block_meta_data &&                                                                      \
-        (curr_block_meta_data < (block_meta_data_t *)((char *)first_meta_block + VM_PAGE_USABLE_SIZE)));        \
+        (curr_block_meta_data < (block_meta_data_t *)((char *)first_meta_block +                         \
+            VM_PAGE_USABLE_SIZE(vm_page_ptr->units))));                                                 \
         (curr_block_meta_data =  NEXT_META_BLOCK(curr_block_meta_data)))                \
     {                                                                                                                                        
 
@@ -137,4 +298,8 @@ void mm_print_vm_page_details(vm_page_t *vm_page);
 
 void mm_print_vm_page_priority_queue(vm_page_family_t *vm_page_family);
 
+#ifdef __cplusplus
+}
+#endif
+
 #endif
\ No newline at end of file
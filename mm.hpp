@@ -0,0 +1,136 @@
+#ifndef MM_HPP_
+#define MM_HPP_
+
+/* Header only C++ front-end over the memory manager.
+ * Every C++ type T is bound to its own vm page family the first time it is
+ * used, through a function local static, so typed allocations go straight
+ * to xcalloc_page_family() and never hit mm_lookup_page_family_by_name().
+ * mm_init() is invoked on demand, calling it up front is still fine.
+ */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdio>
+#include <new>
+#include <utility>
+#include "uapi_mm.h"
+
+namespace mm {
+
+namespace detail {
+
+/* Payloads sit right behind a block_meta_data_t, nothing stricter can be honoured */
+constexpr std::size_t max_alignment = alignof(block_meta_data_t);
+
+inline vm_page_family_t *register_family(uint32_t struct_size)
+{
+    /* The registry is keyed by name only, hand out names no C struct can clash with */
+    static std::atomic<unsigned int> next_family_id{0U};
+    char struct_name[MM_MAX_STRUCT_NAME];
+
+    mm_init();
+    std::snprintf(struct_name, sizeof(struct_name), "c++#%u<%u>",
+                  next_family_id.fetch_add(1U), struct_size);
+    return mm_instantiate_new_page_family(struct_name, struct_size);
+}
+
+template <typename T>
+struct family {
+    static_assert(alignof(T) <= max_alignment,
+                  "over aligned types can not be served by the memory manager");
+
+    static constexpr uint32_t struct_size = sizeof(T);
+
+    static vm_page_family_t *get()
+    {
+        static vm_page_family_t *const vm_page_family = register_family(struct_size);
+        return vm_page_family;
+    }
+
+    /* Biggest n which still fits in a single vm page */
+    static std::size_t max_units()
+    {
+        static const std::size_t units = get() ? mm_page_family_max_units(get()) : 0U;
+        return units;
+    }
+};
+
+} // namespace detail
+
+/* STL allocator. Requests which do not fit in a vm page (vector growth,
+ * hash bucket arrays) are forwarded to ::operator new; the decision only
+ * depends on n, so deallocate() always takes the same route back.
+ */
+template <typename T>
+class allocator {
+public:
+    using value_type = T;
+
+    allocator() noexcept = default;
+
+    template <typename U>
+    allocator(const allocator<U> &) noexcept {}
+
+    T *allocate(std::size_t n)
+    {
+        /* no family (registration failed) would send everything to ::operator new unnoticed */
+        if (n == 0 || !detail::family<T>::get())
+            throw std::bad_alloc();
+        if (n <= detail::family<T>::max_units()) {
+            void *mem = xcalloc_page_family(detail::family<T>::get(), static_cast<int>(n));
+            if (!mem)
+                throw std::bad_alloc();
+            return static_cast<T *>(mem);
+        }
+        return static_cast<T *>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T *ptr, std::size_t n) noexcept
+    {
+        if (n <= detail::family<T>::max_units()) {
+            xfree(ptr);
+            return;
+        }
+        ::operator delete(ptr);
+    }
+
+    template <typename U>
+    bool operator==(const allocator<U> &) const noexcept { return true; }
+
+    template <typename U>
+    bool operator!=(const allocator<U> &) const noexcept { return false; }
+};
+
+/* Object pool, constructs in place on top of the family's blocks */
+template <typename T>
+class pool {
+public:
+    template <typename... Args>
+    static T *make(Args &&...args)
+    {
+        vm_page_family_t *vm_page_family = detail::family<T>::get();
+        void *mem = vm_page_family ? xcalloc_page_family(vm_page_family, 1) : nullptr;
+        if (!mem)
+            throw std::bad_alloc();
+        try {
+            return ::new (mem) T(std::forward<Args>(args)...);
+        } catch (...) {
+            xfree(mem);
+            throw;
+        }
+    }
+
+    static void destroy(T *obj) noexcept
+    {
+        if (!obj)
+            return;
+        obj->~T();
+        xfree(obj);
+    }
+
+    static vm_page_family_t *page_family() { return detail::family<T>::get(); }
+};
+
+} // namespace mm
+
+#endif
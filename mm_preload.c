@@ -0,0 +1,154 @@
+/* LD_PRELOAD shim routing the libc heap through the memory manager:
+ *
+ *      make libmm_preload.so
+ *      LD_PRELOAD=./libmm_preload.so <unmodified binary>
+ *
+ * The manager is single writer per page family, so the shim serialises every
+ * call on one mutex and turns off remote free deferral, which it does not need.
+ * The library is built with hidden visibility: only the libc entry points below
+ * are exported, so binaries with their own xmalloc() (libiberty) can not
+ * interpose on the manager's.
+ */
+#include <errno.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "uapi_mm.h"
+
+#define MM_PRELOAD_EXPORT __attribute__((visibility("default")))
+
+static pthread_mutex_t mm_preload_mutex = PTHREAD_MUTEX_INITIALIZER;
+static vm_bool_t mm_preload_initialized = MM_FALSE;
+
+static inline void mm_preload_lock(void)
+{
+    pthread_mutex_lock(&mm_preload_mutex);
+    if(!mm_preload_initialized){
+        mm_init();
+        mm_set_remote_free_mode(MM_FALSE);
+        mm_preload_initialized = MM_TRUE;
+    }
+}
+
+static inline void mm_preload_unlock(void)
+{
+    pthread_mutex_unlock(&mm_preload_mutex);
+}
+
+/* fork() must not snapshot the heap halfway through a call, nor leave the
+ * child waiting on a mutex held by a thread that does not exist there */
+static void mm_preload_atfork_prepare(void)
+{
+    pthread_mutex_lock(&mm_preload_mutex);
+}
+
+static void mm_preload_atfork_parent(void)
+{
+    pthread_mutex_unlock(&mm_preload_mutex);
+}
+
+static void mm_preload_atfork_child(void)
+{
+    pthread_mutex_init(&mm_preload_mutex, NULL);
+}
+
+/* at load time, not under the mutex: registering may itself call malloc() */
+__attribute__((constructor)) static void mm_preload_register_atfork(void)
+{
+    pthread_atfork(mm_preload_atfork_prepare, mm_preload_atfork_parent, mm_preload_atfork_child);
+}
+
+MM_PRELOAD_EXPORT void *malloc(size_t size)
+{
+    void *ptr;
+    mm_preload_lock();
+    ptr = xmalloc(size);
+    mm_preload_unlock();
+    if(!ptr)
+        errno = ENOMEM;
+    return ptr;
+}
+
+MM_PRELOAD_EXPORT void free(void *ptr)
+{
+    if(!ptr)
+        return;
+    mm_preload_lock();
+    xfree(ptr);
+    mm_preload_unlock();
+}
+
+MM_PRELOAD_EXPORT void *calloc(size_t nmemb, size_t size)
+{
+    void *ptr;
+    size_t total;
+
+    if(__builtin_mul_overflow(nmemb, size, &total)){
+        errno = ENOMEM;
+        return NULL;
+    }
+    /* not through malloc(): the compiler folds malloc() + memset() back into calloc() */
+    mm_preload_lock();
+    ptr = xmalloc(total);
+    mm_preload_unlock();
+    if(!ptr){
+        errno = ENOMEM;
+        return NULL;
+    }
+    memset(ptr, 0, total);
+    return ptr;
+}
+
+MM_PRELOAD_EXPORT void *realloc(void *ptr, size_t size)
+{
+    void *new_ptr;
+
+    if(ptr && !size){
+        free(ptr);
+        return NULL;
+    }
+    mm_preload_lock();
+    new_ptr = xrealloc(ptr, size);
+    mm_preload_unlock();
+    if(!new_ptr)
+        errno = ENOMEM;
+    return new_ptr;
+}
+
+MM_PRELOAD_EXPORT int posix_memalign(void **memptr, size_t alignment, size_t size)
+{
+    void *ptr;
+
+    if(!alignment || (alignment & (alignment - 1)) || (alignment % sizeof(void *)))
+        return EINVAL;
+    mm_preload_lock();
+    ptr = xmemalign(alignment, size);
+    mm_preload_unlock();
+    if(!ptr)
+        return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+MM_PRELOAD_EXPORT void *aligned_alloc(size_t alignment, size_t size)
+{
+    void *ptr = NULL;
+    int rc = posix_memalign(&ptr, alignment < sizeof(void *) ? sizeof(void *) : alignment, size);
+    if(rc){
+        errno = rc;
+        return NULL;
+    }
+    return ptr;
+}
+
+MM_PRELOAD_EXPORT void *memalign(size_t alignment, size_t size)
+{
+    return aligned_alloc(alignment, size);
+}
+
+MM_PRELOAD_EXPORT size_t malloc_usable_size(void *ptr)
+{
+    if(!ptr)
+        return 0;
+    return xmalloc_usable_size(ptr);
+}
@@ -0,0 +1,456 @@
+/* Replays an allocation trace recorded with mm_trace_start(), single threaded
+ * and in timestamp order, against the memory manager or against glibc:
+ *
+ *      make mm_replay.bin
+ *      ./mm_replay.bin <trace file> [--glibc]
+ *
+ * Each family is rebuilt as the kind of family it was traced as. Reports
+ * throughput, a per operation latency histogram and, for both allocators
+ * alike, how far the resident set grew over its size at the start of the
+ * replay (sampled every REPLAY_RSS_SAMPLE_RECORDS records), plus the peak
+ * vm page count for the manager.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "uapi_mm.h"
+#include "mm_trace.h"
+
+#define REPLAY_LATENCY_BUCKETS 40U
+#define REPLAY_RSS_SAMPLE_RECORDS 256U
+
+typedef struct replay_family_{
+    vm_bool_t registered;
+    uint32_t struct_size;
+    vm_page_family_type_t family_type;
+    vm_page_family_t *vm_page_family;
+}replay_family_t;
+
+typedef struct replay_object_{
+    uint64_t object_id;     /* 0 marks an empty slot */
+    void *ptr;
+    uint32_t family_id;
+}replay_object_t;
+
+typedef struct replay_state_{
+    vm_bool_t use_glibc;
+    replay_family_t *families;
+    uint32_t n_families;
+    replay_object_t *objects;   /* open addressing, linear probing */
+    uint64_t objects_capacity;
+    uint64_t objects_count;
+    uint64_t latency_histogram[REPLAY_LATENCY_BUCKETS];
+    uint64_t n_allocs;
+    uint64_t n_frees;
+    uint64_t n_resets;
+    uint64_t n_region_frees;
+    uint64_t n_unmatched_frees;
+    uint64_t n_failed_allocs;
+    uint32_t peak_vm_pages;
+    long start_rss_pages;
+    long peak_rss_pages;
+}replay_state_t;
+
+static uint64_t replay_now_ns(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/* Resident pages right now, read without going through malloc() */
+static long replay_rss_pages(void)
+{
+    char buffer[128];
+    long size = 0, resident = 0;
+    ssize_t n;
+    int fd = open("/proc/self/statm", O_RDONLY);
+
+    if(fd < 0)
+        return 0;
+    n = read(fd, buffer, sizeof(buffer) - 1U);
+    close(fd);
+    if(n <= 0)
+        return 0;
+    buffer[n] = '\0';
+    if(sscanf(buffer, "%ld %ld", &size, &resident) != 2)
+        return 0;
+    return resident;
+}
+
+static void replay_sample_rss(replay_state_t *state)
+{
+    long rss_pages = replay_rss_pages();
+
+    if(rss_pages > state->peak_rss_pages)
+        state->peak_rss_pages = rss_pages;
+}
+
+static inline uint64_t replay_hash(uint64_t object_id)
+{
+    object_id ^= object_id >> 33;
+    object_id *= 0xff51afd7ed558ccdULL;
+    object_id ^= object_id >> 33;
+    return object_id;
+}
+
+static void replay_objects_insert(replay_state_t *state, uint64_t object_id, void *ptr, uint32_t family_id);
+
+static void replay_objects_resize(replay_state_t *state, uint64_t capacity)
+{
+    replay_object_t *old_objects = state->objects;
+    uint64_t old_capacity = state->objects_capacity;
+    uint64_t i;
+
+    state->objects = calloc(capacity, sizeof(replay_object_t));
+    if(!state->objects){
+        fprintf(stderr, "Error: out of memory for the object table\n");
+        exit(1);
+    }
+    state->objects_capacity = capacity;
+    state->objects_count = 0U;
+    for(i = 0U; i < old_capacity; i++){
+        if(old_objects[i].object_id)
+            replay_objects_insert(state, old_objects[i].object_id, old_objects[i].ptr, old_objects[i].family_id);
+    }
+    free(old_objects);
+}
+
+static void replay_objects_insert(replay_state_t *state, uint64_t object_id, void *ptr, uint32_t family_id)
+{
+    uint64_t mask;
+    uint64_t i;
+
+    if((state->objects_count + 1U) * 2U > state->objects_capacity)
+        replay_objects_resize(state, state->objects_capacity ? state->objects_capacity * 2U : 1024U);
+    mask = state->objects_capacity - 1U;
+    for(i = replay_hash(object_id) & mask; state->objects[i].object_id; i = (i + 1U) & mask){
+        if(state->objects[i].object_id == object_id)
+            break;
+    }
+    if(!state->objects[i].object_id)
+        state->objects_count++;
+    state->objects[i].object_id = object_id;
+    state->objects[i].ptr = ptr;
+    state->objects[i].family_id = family_id;
+}
+
+/* Removes and returns the entry, backward shift deletion keeps probing correct */
+static vm_bool_t replay_objects_remove(replay_state_t *state, uint64_t object_id, replay_object_t *removed)
+{
+    uint64_t mask = state->objects_capacity - 1U;
+    uint64_t i, j, home;
+
+    if(!state->objects_capacity)
+        return MM_FALSE;
+    for(i = replay_hash(object_id) & mask; state->objects[i].object_id != object_id; i = (i + 1U) & mask){
+        if(!state->objects[i].object_id)
+            return MM_FALSE;
+    }
+    *removed = state->objects[i];
+    for(j = (i + 1U) & mask; state->objects[j].object_id; j = (j + 1U) & mask){
+        home = replay_hash(state->objects[j].object_id) & mask;
+        /* j may fill the hole if the hole lies cyclically within [home, j) */
+        if((home <= j) ? (home <= i && i < j) : (home <= i || i < j)){
+            state->objects[i] = state->objects[j];
+            i = j;
+        }
+    }
+    state->objects[i].object_id = 0U;
+    state->objects_count--;
+    return MM_TRUE;
+}
+
+static replay_family_t *replay_family(replay_state_t *state, uint32_t family_id)
+{
+    uint32_t n;
+
+    if(family_id >= state->n_families){
+        n = family_id + 1U;
+        state->families = realloc(state->families, n * sizeof(replay_family_t));
+        if(!state->families){
+            fprintf(stderr, "Error: out of memory for the family table\n");
+            exit(1);
+        }
+        memset(&state->families[state->n_families], 0, (n - state->n_families) * sizeof(replay_family_t));
+        state->n_families = n;
+    }
+    return &state->families[family_id];
+}
+
+static void replay_register(replay_state_t *state, mm_trace_record_t *record)
+{
+    replay_family_t *family = replay_family(state, record->family_id);
+    char struct_name[MM_MAX_STRUCT_NAME];
+
+    if(family->registered)
+        return;
+    family->registered = MM_TRUE;
+    family->struct_size = record->units;
+    family->family_type = (vm_page_family_type_t)record->object_id;
+    if(state->use_glibc)
+        return;
+    snprintf(struct_name, sizeof(struct_name), "replay_%u", record->family_id);
+    switch(family->family_type){
+        case MM_PAGE_FAMILY_REGION:
+            family->vm_page_family = mm_instantiate_new_region_family(struct_name, record->units, 0U);
+            break;
+        case MM_PAGE_FAMILY_OBJECT_CACHE:
+            /* the constructors are not in the trace, slots stay as the kernel gave them */
+            family->vm_page_family = mm_instantiate_new_cache_family(struct_name, record->units, NULL, NULL);
+            break;
+        case MM_PAGE_FAMILY_OUT_OF_BAND:
+            family->vm_page_family = mm_instantiate_new_oob_family(struct_name, record->units);
+            break;
+        case MM_PAGE_FAMILY_SHARDED:
+            family->vm_page_family = mm_instantiate_new_sharded_family(struct_name, record->units, 0U);
+            break;
+        default:
+            family->vm_page_family = mm_instantiate_new_page_family(struct_name, record->units);
+            break;
+    }
+}
+
+static vm_bool_t replay_is_region(replay_state_t *state, uint32_t family_id)
+{
+    return family_id != MM_TRACE_HUGE_FAMILY_ID &&
+           replay_family(state, family_id)->family_type == MM_PAGE_FAMILY_REGION ? MM_TRUE : MM_FALSE;
+}
+
+static void *replay_alloc(replay_state_t *state, mm_trace_record_t *record)
+{
+    replay_family_t *family = NULL;
+
+    if(record->family_id == MM_TRACE_HUGE_FAMILY_ID)
+        return state->use_glibc ? malloc(record->units) : xmalloc(record->units);
+
+    family = replay_family(state, record->family_id);
+    if(!family->registered)
+        return NULL;
+    if(state->use_glibc)
+        return calloc(record->units, family->struct_size);
+    return family->vm_page_family ? xcalloc_page_family(family->vm_page_family, (int)record->units) : NULL;
+}
+
+static void replay_free(replay_state_t *state, void *ptr)
+{
+    if(state->use_glibc)
+        free(ptr);
+    else
+        xfree(ptr);
+}
+
+/* Region reset: every live object of the family goes at once, in place so
+ * the object table does not change size under the measurement. The scan
+ * starts just past an empty slot: no cluster wraps around it, so a backward
+ * shift only ever pulls an entry into the slot being looked at */
+static void replay_reset(replay_state_t *state, mm_trace_record_t *record)
+{
+    replay_family_t *family = replay_family(state, record->family_id);
+    uint64_t mask = state->objects_capacity - 1U;
+    replay_object_t removed;
+    replay_object_t *object = NULL;
+    uint64_t start, n;
+
+    for(start = 0U; start < state->objects_capacity && state->objects[start].object_id; start++);
+    for(n = 0U; n < state->objects_capacity; ){
+        object = &state->objects[(start + n) & mask];
+        if(!object->object_id || object->family_id != record->family_id){
+            n++;
+            continue;
+        }
+        replay_objects_remove(state, object->object_id, &removed);
+        if(state->use_glibc)
+            free(removed.ptr);
+    }
+    if(!state->use_glibc && family->vm_page_family)
+        mm_region_reset(family->vm_page_family);
+}
+
+static void replay_one(replay_state_t *state, mm_trace_record_t *record)
+{
+    replay_object_t removed;
+    void *ptr = NULL;
+
+    switch(record->op){
+        case MM_TRACE_OP_REGISTER:
+            replay_register(state, record);
+            break;
+        case MM_TRACE_OP_ALLOC:
+            ptr = replay_alloc(state, record);
+            if(!ptr){
+                state->n_failed_allocs++;
+                break;
+            }
+            replay_objects_insert(state, record->object_id, ptr, record->family_id);
+            state->n_allocs++;
+            break;
+        case MM_TRACE_OP_FREE:
+            /* xfree() leaves region objects alone, they go with the next reset */
+            if(replay_is_region(state, record->family_id)){
+                state->n_region_frees++;
+                break;
+            }
+            /* objects allocated before the trace started were never seen */
+            if(!replay_objects_remove(state, record->object_id, &removed)){
+                state->n_unmatched_frees++;
+                break;
+            }
+            replay_free(state, removed.ptr);
+            state->n_frees++;
+            break;
+        case MM_TRACE_OP_RESET:
+            replay_reset(state, record);
+            state->n_resets++;
+            break;
+        default:
+            break;
+    }
+}
+
+static int replay_record_compare(const void *a, const void *b)
+{
+    const mm_trace_record_t *record_a = *(mm_trace_record_t * const *)a;
+    const mm_trace_record_t *record_b = *(mm_trace_record_t * const *)b;
+
+    if(record_a->timestamp_ns != record_b->timestamp_ns)
+        return record_a->timestamp_ns < record_b->timestamp_ns ? -1 : 1;
+    /* a family's description comes before anything done to it in the same nanosecond */
+    if((record_a->op == MM_TRACE_OP_REGISTER) != (record_b->op == MM_TRACE_OP_REGISTER))
+        return record_a->op == MM_TRACE_OP_REGISTER ? -1 : 1;
+    /* same timestamp: keep file order, which is program order within a thread */
+    return (record_a > record_b) - (record_a < record_b);
+}
+
+static mm_trace_record_t *replay_load(char *path, uint64_t *n_records)
+{
+    mm_trace_file_header_t header;
+    mm_trace_record_t *records = NULL;
+    FILE *fp = fopen(path, "rb");
+    long size;
+
+    if(!fp){
+        fprintf(stderr, "Error: could not open %s\n", path);
+        return NULL;
+    }
+    if(fread(&header, sizeof(header), 1, fp) != 1 ||
+        memcmp(header.magic, MM_TRACE_MAGIC, sizeof(header.magic)) ||
+        header.version != MM_TRACE_VERSION || header.record_size != sizeof(mm_trace_record_t)){
+        fprintf(stderr, "Error: %s is not a version %u allocation trace\n", path, MM_TRACE_VERSION);
+        fclose(fp);
+        return NULL;
+    }
+    fseek(fp, 0, SEEK_END);
+    size = ftell(fp) - (long)sizeof(header);
+    fseek(fp, sizeof(header), SEEK_SET);
+
+    *n_records = (uint64_t)size / sizeof(mm_trace_record_t);
+    records = malloc(*n_records * sizeof(mm_trace_record_t) + 1U);
+    if(!records || fread(records, sizeof(mm_trace_record_t), *n_records, fp) != *n_records){
+        fprintf(stderr, "Error: could not read %s\n", path);
+        free(records);
+        records = NULL;
+    }
+    fclose(fp);
+    return records;
+}
+
+static void replay_report(replay_state_t *state, uint64_t elapsed_ns)
+{
+    uint64_t total_ops = state->n_allocs + state->n_frees + state->n_region_frees + state->n_resets;
+    long rss_growth = state->peak_rss_pages - state->start_rss_pages;
+    uint32_t i;
+
+    printf("Replayed against   : %s\n", state->use_glibc ? "glibc" : "memory manager");
+    printf("Allocations        : %lu (%lu failed)\n", state->n_allocs, state->n_failed_allocs);
+    printf("Frees              : %lu (%lu not matched in trace)\n", state->n_frees, state->n_unmatched_frees);
+    printf("Region frees       : %lu (left to the reset)\n", state->n_region_frees);
+    printf("Region resets      : %lu\n", state->n_resets);
+    printf("Elapsed            : %.3f ms\n", elapsed_ns / 1e6);
+    printf("Throughput         : %.0f ops/s\n", elapsed_ns ? total_ops * 1e9 / elapsed_ns : 0.0);
+
+    printf("Peak RSS growth    : %ld KB (%ld pages)\n", rss_growth * getpagesize() / 1024, rss_growth);
+    if(!state->use_glibc)
+        printf("Peak vm pages      : %u (%lu KB)\n", state->peak_vm_pages,
+                (unsigned long)state->peak_vm_pages * getpagesize() / 1024);
+
+    printf("Latency histogram  :\n");
+    for(i = 0U; i < REPLAY_LATENCY_BUCKETS; i++){
+        if(!state->latency_histogram[i])
+            continue;
+        printf("\t< %12lu ns : %lu\n", 1UL << (i + 1U), state->latency_histogram[i]);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    replay_state_t state;
+    mm_trace_record_t *records = NULL;
+    mm_trace_record_t **order = NULL;
+    uint64_t n_records = 0U;
+    uint64_t n_allocs = 0U;
+    uint64_t capacity = 1024U;
+    uint64_t start_ns, op_start_ns, latency_ns;
+    uint64_t i;
+    uint32_t bucket, vm_pages;
+
+    if(argc < 2){
+        fprintf(stderr, "Usage: %s <trace file> [--glibc]\n", argv[0]);
+        return 1;
+    }
+    memset(&state, 0, sizeof(state));
+    state.use_glibc = (argc > 2 && strcmp(argv[2], "--glibc") == 0) ? MM_TRUE : MM_FALSE;
+
+    records = replay_load(argv[1], &n_records);
+    if(!records)
+        return 1;
+    order = malloc(n_records * sizeof(mm_trace_record_t *) + 1U);
+    if(!order)
+        return 1;
+    for(i = 0U; i < n_records; i++){
+        order[i] = &records[i];
+        n_allocs += records[i].op == MM_TRACE_OP_ALLOC;
+    }
+    qsort(order, n_records, sizeof(mm_trace_record_t *), replay_record_compare);
+
+    if(!state.use_glibc){
+        mm_init();
+        mm_set_remote_free_mode(MM_FALSE);
+    }
+    /* the object table never grows during the replay and is already
+     * resident, only the allocator under test moves the RSS */
+    while(capacity < (n_allocs + 1U) * 2U)
+        capacity *= 2U;
+    replay_objects_resize(&state, capacity);
+    memset(state.objects, 0, capacity * sizeof(replay_object_t));
+    state.start_rss_pages = state.peak_rss_pages = replay_rss_pages();
+
+    start_ns = replay_now_ns();
+    for(i = 0U; i < n_records; i++){
+        op_start_ns = replay_now_ns();
+        replay_one(&state, order[i]);
+        latency_ns = replay_now_ns() - op_start_ns;
+
+        bucket = latency_ns ? (uint32_t)(63 - __builtin_clzll(latency_ns)) : 0U;
+        if(bucket >= REPLAY_LATENCY_BUCKETS)
+            bucket = REPLAY_LATENCY_BUCKETS - 1U;
+        if(order[i]->op != MM_TRACE_OP_REGISTER)
+            state.latency_histogram[bucket]++;
+        if(!state.use_glibc){
+            vm_pages = mm_get_total_vm_page_count();
+            if(vm_pages > state.peak_vm_pages)
+                state.peak_vm_pages = vm_pages;
+        }
+        if(!(i % REPLAY_RSS_SAMPLE_RECORDS))
+            replay_sample_rss(&state);
+    }
+    replay_sample_rss(&state);
+    replay_report(&state, replay_now_ns() - start_ns);
+
+    free(order);
+    free(records);
+    return 0;
+}
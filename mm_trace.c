@@ -0,0 +1,168 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include "mm_trace.h"
+#include "uapi_mm.h"
+
+typedef struct mm_trace_buffer_{
+    struct mm_trace_buffer_ *next;  /* every buffer of the session, for mm_trace_stop() */
+    uint32_t count;
+    mm_trace_record_t records[MM_TRACE_BUFFER_RECORDS];
+}mm_trace_buffer_t;
+
+vm_bool_t mm_trace_enabled = MM_FALSE;
+
+static int mm_trace_fd = -1;
+static uint32_t mm_trace_session = 0U;
+static mm_trace_buffer_t *mm_trace_buffers = NULL;
+static pthread_mutex_t mm_trace_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static __thread mm_trace_buffer_t *mm_trace_thread_buffer = NULL;
+static __thread uint32_t mm_trace_thread_session = 0U;
+static __thread uint32_t mm_trace_thread_id = 0U;
+
+static void mm_trace_flush(mm_trace_buffer_t *buffer)
+{
+    if(!buffer->count)
+        return;
+    /* O_APPEND keeps each batch in one piece when threads flush together */
+    if(write(mm_trace_fd, buffer->records, buffer->count * sizeof(mm_trace_record_t)) < 0)
+        printf("Error: %s() - could not write allocation trace\n", __FUNCTION__);
+    buffer->count = 0U;
+}
+
+/* Buffers come straight from mmap so the recorder never recurses into xmalloc() */
+static mm_trace_buffer_t *mm_trace_get_thread_buffer(void)
+{
+    mm_trace_buffer_t *buffer = NULL;
+
+    if(mm_trace_thread_buffer && mm_trace_thread_session == mm_trace_session)
+        return mm_trace_thread_buffer;
+
+    buffer = mmap(0, sizeof(mm_trace_buffer_t), PROT_READ | PROT_WRITE, MAP_ANON | MAP_PRIVATE, -1, 0);
+    if(buffer == MAP_FAILED)
+        return NULL;
+    buffer->count = 0U;
+    pthread_mutex_lock(&mm_trace_mutex);
+    buffer->next = mm_trace_buffers;
+    mm_trace_buffers = buffer;
+    pthread_mutex_unlock(&mm_trace_mutex);
+
+    if(!mm_trace_thread_id)
+        mm_trace_thread_id = (uint32_t)syscall(SYS_gettid);
+    mm_trace_thread_buffer = buffer;
+    mm_trace_thread_session = mm_trace_session;
+    return buffer;
+}
+
+static void mm_trace_append(mm_trace_buffer_t *buffer, uint64_t timestamp_ns, mm_trace_op_t op,
+    uint32_t family_id, uint32_t units, uint64_t object_id)
+{
+    mm_trace_record_t *record = &buffer->records[buffer->count++];
+
+    record->timestamp_ns = timestamp_ns;
+    record->object_id = object_id;
+    record->thread_id = mm_trace_thread_id;
+    record->family_id = family_id;
+    record->units = units;
+    record->op = op;
+    if(buffer->count == MM_TRACE_BUFFER_RECORDS)
+        mm_trace_flush(buffer);
+}
+
+static inline uint64_t mm_trace_now_ns(void)
+{
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+void mm_trace_record(mm_trace_op_t op, vm_page_family_t *vm_page_family, uint32_t units, void *object)
+{
+    mm_trace_buffer_t *buffer = mm_trace_get_thread_buffer();
+
+    if(!buffer)
+        return;
+    if(!vm_page_family){
+        mm_trace_append(buffer, mm_trace_now_ns(), op, MM_TRACE_HUGE_FAMILY_ID, units, (uint64_t)(uintptr_t)object);
+        return;
+    }
+    /* shards are an implementation detail, the registered family is traced */
+    if(vm_page_family->shard_parent)
+        vm_page_family = vm_page_family->shard_parent;
+    /* describe the family the first time this session sees it. REGISTER is
+     * stamped before the family is published as seen and every op after it
+     * sees that, so mm_replay's time sort always puts REGISTER first */
+    if(__atomic_load_n(&vm_page_family->trace_session, __ATOMIC_ACQUIRE) != mm_trace_session){
+        pthread_mutex_lock(&mm_trace_mutex);
+        if(vm_page_family->trace_session != mm_trace_session){
+            mm_trace_append(buffer, mm_trace_now_ns(), MM_TRACE_OP_REGISTER, vm_page_family->family_id,
+                            vm_page_family->struct_size, vm_page_family->family_type);
+            __atomic_store_n(&vm_page_family->trace_session, mm_trace_session, __ATOMIC_RELEASE);
+        }
+        pthread_mutex_unlock(&mm_trace_mutex);
+    }
+    mm_trace_append(buffer, mm_trace_now_ns(), op, vm_page_family->family_id, units, (uint64_t)(uintptr_t)object);
+}
+
+vm_bool_t mm_trace_start(char *path)
+{
+    mm_trace_file_header_t header;
+
+    if(mm_trace_enabled){
+        printf("Error: %s() - a trace is already running\n", __FUNCTION__);
+        return MM_FALSE;
+    }
+    mm_trace_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if(mm_trace_fd < 0){
+        printf("Error: %s() - could not open %s\n", __FUNCTION__, path);
+        return MM_FALSE;
+    }
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, MM_TRACE_MAGIC, sizeof(header.magic));
+    header.version = MM_TRACE_VERSION;
+    header.record_size = sizeof(mm_trace_record_t);
+    if(write(mm_trace_fd, &header, sizeof(header)) != sizeof(header)){
+        printf("Error: %s() - could not write trace header\n", __FUNCTION__);
+        close(mm_trace_fd);
+        mm_trace_fd = -1;
+        return MM_FALSE;
+    }
+    /* session 0 is never used, freshly registered families always emit a REGISTER */
+    mm_trace_session++;
+    __atomic_store_n(&mm_trace_enabled, MM_TRUE, __ATOMIC_RELEASE);
+    return MM_TRUE;
+}
+
+/* Expects the traced threads to be quiescent: every buffer, including the
+ * ones of threads which already exited, is flushed and released here.
+ */
+void mm_trace_stop(void)
+{
+    mm_trace_buffer_t *buffer = NULL;
+    mm_trace_buffer_t *next = NULL;
+
+    if(!mm_trace_enabled)
+        return;
+    __atomic_store_n(&mm_trace_enabled, MM_FALSE, __ATOMIC_RELEASE);
+
+    pthread_mutex_lock(&mm_trace_mutex);
+    for(buffer = mm_trace_buffers; buffer; buffer = next){
+        next = buffer->next;
+        mm_trace_flush(buffer);
+        munmap(buffer, sizeof(mm_trace_buffer_t));
+    }
+    mm_trace_buffers = NULL;
+    /* live threads notice the stale session and map a new buffer next time */
+    mm_trace_session++;
+    pthread_mutex_unlock(&mm_trace_mutex);
+
+    close(mm_trace_fd);
+    mm_trace_fd = -1;
+}
@@ -0,0 +1,53 @@
+#ifndef MM_TRACE_H_
+#define MM_TRACE_H_
+
+/* Allocation trace: a header followed by fixed size records, one per
+ * xcalloc()/xfree()/region reset, written in per-thread batches (so only
+ * roughly ordered, sort by timestamp before replaying). A family shows up
+ * with an MM_TRACE_OP_REGISTER record before its first operation, which
+ * carries its vm_page_family_type_t so a replay can build the same kind of
+ * family. Operations on a shard are recorded against its sharded family.
+ */
+
+#include <stdint.h>
+#include "mm.h"
+
+#define MM_TRACE_MAGIC          "MMTRACE1"
+#define MM_TRACE_VERSION        1U
+#define MM_TRACE_HUGE_FAMILY_ID UINT32_MAX  /* xmalloc() blocks with no family, units is the size */
+#define MM_TRACE_BUFFER_RECORDS 512U
+
+typedef enum{
+    MM_TRACE_OP_REGISTER,   /* units = struct size, object_id = vm_page_family_type_t */
+    MM_TRACE_OP_ALLOC,
+    MM_TRACE_OP_FREE,
+    MM_TRACE_OP_RESET       /* mm_region_reset() */
+}mm_trace_op_t;
+
+typedef struct mm_trace_file_header_{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+}mm_trace_file_header_t;
+
+typedef struct mm_trace_record_{
+    uint64_t timestamp_ns;
+    uint64_t object_id;     /* the object address, unique among live objects */
+    uint32_t thread_id;
+    uint32_t family_id;
+    uint32_t units;
+    uint32_t op;
+}mm_trace_record_t;
+
+extern vm_bool_t mm_trace_enabled;
+
+void mm_trace_record(mm_trace_op_t op, vm_page_family_t *vm_page_family, uint32_t units, void *object);
+
+/* One predictable branch on the allocation paths while no trace is running */
+#define MM_TRACE(op, vm_page_family, units, object)                          \
+    do{                                                                      \
+        if(__builtin_expect(mm_trace_enabled, MM_FALSE))                     \
+            mm_trace_record(op, vm_page_family, units, object);              \
+    }while(0)
+
+#endif
@@ -0,0 +1,137 @@
+/* Object cache families: ctor runs once per slot when its vm page is
+ * populated, xcalloc() hands back constructed objects as xfree() left them,
+ * dtor runs only when an empty vm page beyond the spare is released, frees
+ * from other threads keep objects constructed, and mm_reserve() builds the
+ * reserved slots up front */
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include "uapi_mm.h"
+
+#define CACHE_MAGIC 0xcafef00dU
+#define MAX_OBJECTS 4096
+
+typedef struct cache_obj_{
+    uint32_t magic;
+    uint32_t uses;
+    pthread_mutex_t lock;
+    char buffer[64];
+}cache_obj_t;
+
+typedef struct cache_reserved_obj_{
+    uint32_t magic;
+    uint32_t uses;
+    pthread_mutex_t lock;
+    char buffer[64];
+}cache_reserved_obj_t;
+
+static int n_ctor = 0;
+static int n_dtor = 0;
+static cache_obj_t *objects[MAX_OBJECTS];
+
+static void cache_obj_ctor(void *object)
+{
+    cache_obj_t *cache_obj = object;
+
+    cache_obj->magic = CACHE_MAGIC;
+    cache_obj->uses = 0U;
+    pthread_mutex_init(&cache_obj->lock, NULL);
+    n_ctor++;
+}
+
+static void cache_obj_dtor(void *object)
+{
+    cache_obj_t *cache_obj = object;
+
+    assert(cache_obj->magic == CACHE_MAGIC);
+    pthread_mutex_destroy(&cache_obj->lock);
+    cache_obj->magic = 0U;
+    n_dtor++;
+}
+
+/* the object is constructed and was not zeroed since its last use */
+static cache_obj_t *use(cache_obj_t *cache_obj)
+{
+    assert(cache_obj && cache_obj->magic == CACHE_MAGIC);
+    pthread_mutex_lock(&cache_obj->lock);
+    cache_obj->uses++;
+    pthread_mutex_unlock(&cache_obj->lock);
+    return cache_obj;
+}
+
+static void *remote_free_fn(void *arg)
+{
+    xfree(arg);
+    return NULL;
+}
+
+static void test_cache(void)
+{
+    vm_page_family_t *vm_page_family = MM_REG_STRUCT_CTOR(cache_obj_t, cache_obj_ctor, cache_obj_dtor);
+    cache_obj_t *cache_obj = NULL;
+    pthread_t thread;
+    int slots = 0;
+    int i;
+
+    cache_obj = use(XCALLOC(1, cache_obj_t));
+    slots = n_ctor;
+    assert(slots > 1 && n_dtor == 0);
+    assert(!XCALLOC(2, cache_obj_t));
+
+    /* the slot just freed comes straight back, as it was left */
+    xfree(cache_obj);
+    assert(XCALLOC(1, cache_obj_t) == cache_obj);
+    assert(use(cache_obj)->uses == 2U);
+    assert(n_ctor == slots);
+
+    /* three pages' worth, then all of it back: the spare page stays built */
+    objects[0] = cache_obj;
+    for(i = 1; i < 3 * slots; i++)
+        objects[i] = use(XCALLOC(1, cache_obj_t));
+    assert(vm_page_family->page_count == 3U && n_ctor == 3 * slots);
+    for(i = 0; i < 3 * slots; i++)
+        xfree(objects[i]);
+    assert(vm_page_family->page_count == 1U && n_dtor == 2 * slots);
+    for(i = 0; i < slots; i++)
+        objects[i] = use(XCALLOC(1, cache_obj_t));
+    assert(vm_page_family->page_count == 1U && n_ctor == 3 * slots);
+
+    /* a free from another thread is drained by the owner's next xcalloc() */
+    cache_obj = objects[0];
+    assert(pthread_create(&thread, NULL, remote_free_fn, cache_obj) == 0);
+    pthread_join(thread, NULL);
+    assert(XCALLOC(1, cache_obj_t) == cache_obj && use(cache_obj)->magic == CACHE_MAGIC);
+    assert(n_ctor == 3 * slots && n_dtor == 2 * slots);
+    for(i = 0; i < slots; i++)
+        xfree(objects[i]);
+}
+
+static void test_reserve(void)
+{
+    vm_page_family_t *vm_page_family = MM_REG_STRUCT_CTOR(cache_reserved_obj_t, cache_obj_ctor, cache_obj_dtor);
+    int ctor_before = n_ctor;
+    int dtor_before = n_dtor;
+    uint32_t pages = mm_reserve(vm_page_family, 200U);
+    int i;
+
+    assert(pages >= 1U && vm_page_family->page_count == pages);
+    assert(n_ctor - ctor_before >= 200);
+    ctor_before = n_ctor;
+    for(i = 0; i < 200; i++)
+        objects[i] = use(xcalloc_page_family(vm_page_family, 1));
+    for(i = 0; i < 200; i++)
+        xfree(objects[i]);
+    /* reserved pages are neither rebuilt nor torn down */
+    assert(n_ctor == ctor_before && n_dtor == dtor_before);
+    assert(vm_page_family->page_count == pages);
+}
+
+int main(void)
+{
+    mm_init();
+    test_cache();
+    test_reserve();
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
@@ -0,0 +1,153 @@
+/* glthread circular list and the counted glthread_list_t wrappers */
+#include <stdio.h>
+#include <assert.h>
+#include "glueThread/glthread.h"
+
+#define N_NODES 8
+
+typedef struct item_{
+    int key;
+    int id; /* insertion order, to check equal keys keep it */
+    glthread_t glue;
+}item_t;
+
+GLTHREAD_TO_STRUCT(glue_to_item, item_t, glue);
+
+static item_t items[N_NODES];
+
+static int item_compare(void *a, void *b)
+{
+    item_t *x = (item_t *)a;
+    item_t *y = (item_t *)b;
+
+    if(x->key < y->key)
+        return -1;
+    return x->key > y->key;
+}
+
+/* checks the list holds exactly ids[] in order, walking both ways */
+static void assert_order(glthread_list_t *list, const int *ids, int n)
+{
+    glthread_t *curr = NULL;
+    int i = 0;
+
+    ITERATE_GLTHREAD_BEGIN(&list->head, curr){
+        assert(i < n);
+        assert(glue_to_item(curr)->id == ids[i]);
+        i++;
+    }ITERATE_GLTHREAD_END(&list->head, curr);
+    assert(i == n);
+    for(curr = list->head.left; curr != &list->head; curr = curr->left)
+        assert(glue_to_item(curr)->id == ids[--i]);
+    assert(i == 0);
+    assert(glthread_list_count(list) == (unsigned int)n);
+    assert(get_glthread_list_count(&list->head) == (unsigned int)n);
+}
+
+static void init_items(void)
+{
+    int i;
+
+    for(i = 0; i < N_NODES; i++){
+        items[i].key = 0;
+        items[i].id = i;
+        init_glthread(&items[i].glue);
+    }
+}
+
+static void test_add_remove_dequeue(void)
+{
+    glthread_list_t list;
+    glthread_t *first = NULL;
+
+    init_items();
+    init_glthread_list(&list);
+    assert(IS_GLTHREAD_LIST_EMPTY(&list.head));
+    assert(glthread_list_count(&list) == 0U);
+    assert(glthread_list_dequeue_first(&list) == NULL);
+    assert(glthread_list_count(&list) == 0U);
+
+    glthread_list_add_last(&list, &items[1].glue);
+    glthread_list_add_last(&list, &items[2].glue);
+    glthread_list_add_first(&list, &items[0].glue);
+    glthread_list_add_last(&list, &items[3].glue);
+    assert_order(&list, (const int[]){0, 1, 2, 3}, 4);
+
+    glthread_list_remove(&list, &items[2].glue);
+    assert(IS_GLTHREAD_LIST_EMPTY(&items[2].glue));
+    assert_order(&list, (const int[]){0, 1, 3}, 3);
+
+    first = glthread_list_dequeue_first(&list);
+    assert(first == &items[0].glue);
+    assert(IS_GLTHREAD_LIST_EMPTY(first));
+    assert_order(&list, (const int[]){1, 3}, 2);
+
+    glthread_list_remove(&list, &items[3].glue);
+    glthread_list_remove(&list, &items[1].glue);
+    assert(IS_GLTHREAD_LIST_EMPTY(&list.head));
+    assert_order(&list, NULL, 0);
+}
+
+/* a node on no list is a self loop: removing it again is harmless and
+ * must not touch the count */
+static void test_remove_count_rule(void)
+{
+    glthread_list_t list;
+
+    init_items();
+    init_glthread_list(&list);
+    glthread_list_add_last(&list, &items[0].glue);
+    glthread_list_add_last(&list, &items[1].glue);
+
+    glthread_list_remove(&list, &items[5].glue);
+    assert(IS_GLTHREAD_LIST_EMPTY(&items[5].glue));
+    assert_order(&list, (const int[]){0, 1}, 2);
+
+    glthread_list_remove(&list, &items[0].glue);
+    glthread_list_remove(&list, &items[0].glue);
+    assert_order(&list, (const int[]){1}, 1);
+
+    /* plain remove_glthread() leaves the count to the caller */
+    remove_glthread(&items[1].glue);
+    assert(IS_GLTHREAD_LIST_EMPTY(&list.head));
+    assert(glthread_list_count(&list) == 1U);
+}
+
+static void test_priority_insert(void)
+{
+    static const int keys[N_NODES] = {5, 1, 3, 9, 3, 1, 7, 3};
+    glthread_list_t list;
+    int i;
+
+    init_items();
+    init_glthread_list(&list);
+    for(i = 0; i < N_NODES; i++){
+        items[i].key = keys[i];
+        glthread_list_priority_insert(&list, &items[i].glue, item_compare, offsetof(item_t, glue));
+    }
+    /* ascending, equal keys in insertion order */
+    assert_order(&list, (const int[]){1, 5, 2, 4, 7, 0, 6, 3}, N_NODES);
+
+    /* the head and the tail are found the same way as the middle */
+    glthread_list_remove(&list, &items[1].glue);
+    items[1].key = 0;
+    glthread_list_priority_insert(&list, &items[1].glue, item_compare, offsetof(item_t, glue));
+    glthread_list_remove(&list, &items[0].glue);
+    items[0].key = 100;
+    glthread_list_priority_insert(&list, &items[0].glue, item_compare, offsetof(item_t, glue));
+    assert_order(&list, (const int[]){1, 5, 2, 4, 7, 6, 3, 0}, N_NODES);
+
+    delete_glthread_list(&list.head);
+    assert(IS_GLTHREAD_LIST_EMPTY(&list.head));
+    for(i = 0; i < N_NODES; i++)
+        assert(IS_GLTHREAD_LIST_EMPTY(&items[i].glue));
+}
+
+int main(void)
+{
+    test_add_remove_dequeue();
+    test_remove_count_rule();
+    test_priority_insert();
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
@@ -0,0 +1,161 @@
+/* Memory limits: the family and global pressure callbacks run at the soft
+ * limit and may make room, every kind of family fails at its hard limit and
+ * recovers once something is given back, and families growing on several
+ * threads at once never take the total past the global hard limit */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include "uapi_mm.h"
+
+#define MAX_OBJECTS     100000
+#define N_THREADS       8
+#define GLOBAL_PAGES    64U
+
+typedef struct limits_obj_{
+    char payload[200];
+}limits_obj_t;
+
+typedef struct held_objects_{
+    void *objects[MAX_OBJECTS];
+    int count;
+    int calls;
+}held_objects_t;
+
+static held_objects_t held;
+static int global_calls = 0;
+static pthread_barrier_t barrier;
+
+/* what a cache in front of the family would do: let go of everything */
+static void release_cb(vm_page_family_t *vm_page_family, void *ctx)
+{
+    held_objects_t *held_objects = ctx;
+
+    (void)vm_page_family;
+    held_objects->calls++;
+    while(held_objects->count)
+        xfree(held_objects->objects[--held_objects->count]);
+}
+
+static void global_cb(vm_page_family_t *vm_page_family, void *ctx)
+{
+    (void)vm_page_family;
+    (void)ctx;
+    global_calls++;
+}
+
+static void test_soft_limit(void)
+{
+    vm_page_family_t *vm_page_family = MM_REG_STRUCT(limits_obj_t);
+    int i;
+
+    mm_set_page_family_memory_limits(vm_page_family, 2U * vm_page_family->page_span * getpagesize(), 0U);
+    mm_register_pressure_callback(vm_page_family, release_cb, &held);
+    mm_register_global_pressure_callback(global_cb, NULL);
+    for(i = 0; i < 5000; i++){
+        held.objects[held.count] = XCALLOC(1, limits_obj_t);
+        assert(held.objects[held.count++]);
+        assert(vm_page_family->page_count <= 2U);
+    }
+    assert(held.calls > 0 && global_calls == held.calls);
+    mm_register_global_pressure_callback(NULL, NULL);
+    release_cb(vm_page_family, &held);
+}
+
+/* fill the family up to 3 vm pages, see xcalloc() fail, give one object back */
+static void check_hard_limit(vm_page_family_t *vm_page_family)
+{
+    int n = 0;
+
+    mm_set_page_family_memory_limits(vm_page_family, 0U, 3U * vm_page_family->page_span * getpagesize());
+    for(n = 0; n < MAX_OBJECTS; n++){
+        held.objects[n] = xcalloc_page_family(vm_page_family, 1);
+        if(!held.objects[n])
+            break;
+    }
+    assert(n > 0 && n < MAX_OBJECTS);
+    assert(vm_page_family->page_count == 3U);
+    assert(!xcalloc_page_family(vm_page_family, 1));
+
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_REGION)
+        mm_region_reset(vm_page_family);
+    else
+        xfree(held.objects[--n]);
+    held.objects[n] = xcalloc_page_family(vm_page_family, 1);
+    assert(held.objects[n]);
+    if(vm_page_family->family_type == MM_PAGE_FAMILY_REGION)
+        return;
+    while(n >= 0)
+        xfree(held.objects[n--]);
+}
+
+static void test_hard_limit(void)
+{
+    check_hard_limit(mm_instantiate_new_page_family("limits_general_obj_t", sizeof(limits_obj_t)));
+    check_hard_limit(mm_instantiate_new_region_family("limits_region_obj_t", sizeof(limits_obj_t), 0U));
+    check_hard_limit(mm_instantiate_new_cache_family("limits_cache_obj_t", sizeof(limits_obj_t), NULL, NULL));
+    check_hard_limit(mm_instantiate_new_oob_family("limits_oob_obj_t", sizeof(limits_obj_t)));
+    /* the limit covers both shards together */
+    check_hard_limit(mm_instantiate_new_sharded_family("limits_sharded_obj_t", sizeof(limits_obj_t), 2U));
+}
+
+/* each thread grows its own family until the global limit stops it */
+static void *global_grow_fn(void *arg)
+{
+    char struct_name[MM_MAX_STRUCT_NAME];
+    vm_page_family_t *vm_page_family = NULL;
+    void **objects = malloc(MAX_OBJECTS * sizeof(void *));
+    int n = 0;
+
+    snprintf(struct_name, sizeof(struct_name), "limits_global_%ld_t", (long)(intptr_t)arg);
+    vm_page_family = mm_instantiate_new_page_family(struct_name, sizeof(limits_obj_t));
+    assert(objects && vm_page_family);
+    pthread_barrier_wait(&barrier);
+    while(n < MAX_OBJECTS && (objects[n] = xcalloc_page_family(vm_page_family, 1)))
+        n++;
+    assert(n < MAX_OBJECTS);
+    /* main checks the total with every thread stopped */
+    pthread_barrier_wait(&barrier);
+    pthread_barrier_wait(&barrier);
+    while(n)
+        xfree(objects[--n]);
+    free(objects);
+    return NULL;
+}
+
+static void test_global_reserve(void)
+{
+    pthread_t threads[N_THREADS];
+    uint32_t limit = mm_get_total_vm_page_count() + GLOBAL_PAGES;
+    intptr_t i;
+
+    mm_set_global_memory_limits(0U, (uint64_t)limit * getpagesize());
+    pthread_barrier_init(&barrier, NULL, N_THREADS + 1);
+    for(i = 0; i < N_THREADS; i++)
+        assert(pthread_create(&threads[i], NULL, global_grow_fn, (void *)i) == 0);
+    pthread_barrier_wait(&barrier);
+    pthread_barrier_wait(&barrier);
+
+    assert(mm_get_total_vm_page_count() <= limit);
+    assert(mm_get_total_vm_page_count() > limit - MM_MAX_PAGE_SPAN);
+    assert(!xmalloc(16U * getpagesize()));
+
+    pthread_barrier_wait(&barrier);
+    for(i = 0; i < N_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&barrier);
+    mm_set_global_memory_limits(0U, 0U);
+    assert(xmalloc(16U * getpagesize()));
+}
+
+int main(void)
+{
+    mm_init();
+    test_soft_limit();
+    test_hard_limit();
+    test_global_reserve();
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
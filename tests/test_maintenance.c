@@ -0,0 +1,99 @@
+/* Maintenance passes: the ready list is sized from single page allocations
+ * since the previous pass (or mm_maintenance_start()), never from everything
+ * allocated before, and manual passes racing the thread and each other are
+ * all counted */
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include "uapi_mm.h"
+
+#define N_PASSERS   4
+#define N_PASSES    500
+
+typedef struct maintenance_obj_{
+    char payload[1900];
+}maintenance_obj_t;
+
+static vm_page_family_t *vm_page_family = NULL;
+static void *objects[4096];
+static int n_objects = 0;
+
+/* vm_pages more single vm pages for the family, taken from the ready list first */
+static void grow(uint32_t vm_pages)
+{
+    uint32_t page_count = vm_page_family->page_count + vm_pages;
+
+    while(vm_page_family->page_count < page_count){
+        objects[n_objects] = XCALLOC(1, maintenance_obj_t);
+        assert(objects[n_objects++]);
+    }
+}
+
+static uint32_t ready_vm_pages(void)
+{
+    mm_stats_t stats;
+
+    mm_get_stats(&stats);
+    return stats.ready_vm_pages;
+}
+
+static void test_first_pass(void)
+{
+    vm_page_family = MM_REG_STRUCT(maintenance_obj_t);
+    assert(vm_page_family->page_span == 1U);
+
+    /* a lifetime of growth before the first pass is not a rate */
+    grow(100U);
+    mm_maintenance_run_once();
+    assert(ready_vm_pages() == 0U);
+    grow(10U);
+    mm_maintenance_run_once();
+    assert(ready_vm_pages() == 10U);
+    /* the family stopped growing, the pages go back */
+    mm_maintenance_run_once();
+    assert(ready_vm_pages() == 0U);
+
+    /* nor is what happened before the thread started */
+    grow(50U);
+    assert(mm_maintenance_start(60U * 60U * 1000U));
+    mm_maintenance_run_once();
+    assert(ready_vm_pages() == 0U);
+}
+
+static void *passer_fn(void *arg)
+{
+    int i;
+
+    (void)arg;
+    for(i = 0; i < N_PASSES; i++)
+        mm_maintenance_run_once();
+    return NULL;
+}
+
+static void test_concurrent_passes(void)
+{
+    pthread_t threads[N_PASSERS];
+    mm_stats_t before, after;
+    int i;
+
+    mm_get_stats(&before);
+    for(i = 0; i < N_PASSERS; i++)
+        assert(pthread_create(&threads[i], NULL, passer_fn, NULL) == 0);
+    for(i = 0; i < N_PASSERS; i++)
+        pthread_join(threads[i], NULL);
+    mm_get_stats(&after);
+    assert(after.maintenance_passes == before.maintenance_passes + N_PASSERS * N_PASSES);
+    mm_maintenance_stop();
+    while(n_objects)
+        xfree(objects[--n_objects]);
+}
+
+int main(void)
+{
+    mm_init();
+    test_first_pass();
+    test_concurrent_passes();
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
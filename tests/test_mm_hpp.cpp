@@ -0,0 +1,132 @@
+/* mm.hpp: std containers on mm::allocator, oversized requests falling back to
+ * ::operator new, std::bad_alloc for n == 0 and for a type with no family,
+ * and mm::pool giving the block back when the constructor throws */
+#include <cassert>
+#include <cstdio>
+#include <list>
+#include <map>
+#include <new>
+#include <stdexcept>
+#include <vector>
+#include "mm.hpp"
+
+struct point {
+    int x;
+    int y;
+};
+
+/* bigger than any vm page span, no family can hold it */
+struct huge {
+    char bytes[1U << 26];
+};
+
+struct throws_on_construction {
+    explicit throws_on_construction(bool fail) : value(1)
+    {
+        if (fail)
+            throw std::runtime_error("construction failed");
+    }
+    int value;
+};
+
+static vm_page_family_t *hosting_family(void *object)
+{
+    block_meta_data_t *block_meta_data = static_cast<block_meta_data_t *>(object) - 1;
+
+    return static_cast<vm_page_t *>(MM_GET_PAGE_FROM_META_BLOCK(block_meta_data))->page_family;
+}
+
+static void test_containers()
+{
+    std::vector<int, mm::allocator<int>> numbers;
+    std::list<point, mm::allocator<point>> points;
+    std::map<int, int, std::less<int>, mm::allocator<std::pair<const int, int>>> squares;
+    mm::allocator<int> int_allocator;
+    int *ints = nullptr;
+    int sum = 0;
+
+    /* grows past a vm page, the big buffers come from ::operator new */
+    for (int i = 0; i < 10000; i++)
+        numbers.push_back(i);
+    for (int i = 0; i < 10000; i++)
+        assert(numbers[i] == i);
+
+    for (int i = 0; i < 1000; i++)
+        points.push_back(point{i, -i});
+    for (const point &p : points)
+        sum += p.x + p.y;
+    assert(sum == 0 && points.size() == 1000U);
+    points.clear();
+
+    for (int i = 0; i < 1000; i++)
+        squares[i] = i * i;
+    assert(squares.size() == 1000U && squares[999] == 999 * 999);
+
+    ints = int_allocator.allocate(4);
+    assert(hosting_family(ints) == mm::detail::family<int>::get());
+    int_allocator.deallocate(ints, 4);
+}
+
+static void test_bad_alloc()
+{
+    bool thrown = false;
+
+    try {
+        mm::allocator<point>().allocate(0);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown);
+
+    thrown = false;
+    try {
+        mm::allocator<huge>().allocate(1);
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown && !mm::detail::family<huge>::get());
+
+    thrown = false;
+    try {
+        mm::pool<huge>::make();
+    } catch (const std::bad_alloc &) {
+        thrown = true;
+    }
+    assert(thrown);
+}
+
+static void count_cb(void *object, void *ctx)
+{
+    (void)object;
+    (*static_cast<uint64_t *>(ctx))++;
+}
+
+static void test_pool()
+{
+    vm_page_family_t *vm_page_family = mm::pool<throws_on_construction>::page_family();
+    throws_on_construction *object = mm::pool<throws_on_construction>::make(false);
+    uint64_t seen = 0U;
+    bool thrown = false;
+
+    assert(object->value == 1 && hosting_family(object) == vm_page_family);
+    try {
+        mm::pool<throws_on_construction>::make(true);
+    } catch (const std::runtime_error &) {
+        thrown = true;
+    }
+    assert(thrown);
+    /* only the first object is live, the failed one went back */
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == 1U);
+    mm::pool<throws_on_construction>::destroy(object);
+    mm::pool<throws_on_construction>::destroy(nullptr);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == 0U);
+}
+
+int main()
+{
+    test_containers();
+    test_bad_alloc();
+    test_pool();
+    std::printf("%s: PASS\n", __FILE__);
+    return 0;
+}
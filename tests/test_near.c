@@ -0,0 +1,75 @@
+/* xcalloc_near(): the hint's own vm page is preferred, and hints that are no
+ * use (NULL, another family's object, an out-of-band object with no meta
+ * block in front of it) fall back to a plain xcalloc() */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "uapi_mm.h"
+
+typedef struct near_obj_{
+    uint64_t key;
+    char payload[56];
+}near_obj_t;
+
+typedef struct near_other_obj_{
+    char payload[24];
+}near_other_obj_t;
+
+static vm_page_t *object_page(void *object)
+{
+    block_meta_data_t *block_meta_data = (block_meta_data_t *)object - 1;
+
+    return (vm_page_t *)MM_GET_PAGE_FROM_META_BLOCK(block_meta_data);
+}
+
+int main(void)
+{
+    vm_page_family_t *vm_page_family = NULL;
+    vm_page_family_t *oob_family = NULL;
+    void *objects[256];
+    void *hint = NULL;
+    void *object = NULL;
+    int i;
+
+    mm_init();
+    vm_page_family = MM_REG_STRUCT(near_obj_t);
+    MM_REG_STRUCT(near_other_obj_t);
+    oob_family = mm_instantiate_new_oob_family("near_oob_obj_t", sizeof(near_obj_t));
+    assert(mm_reserve(vm_page_family, 256U) > 1U);
+
+    /* fill a few pages, then punch a hole in the first one */
+    for(i = 0; i < 256; i++)
+        objects[i] = XCALLOC(1, near_obj_t);
+    hint = objects[0];
+    xfree(objects[1]);
+    object = XCALLOC_NEAR(hint, 1, near_obj_t);
+    assert(object_page(object) == object_page(hint));
+    xfree(object);
+
+    /* useless hints still allocate */
+    object = XCALLOC_NEAR(NULL, 1, near_obj_t);
+    assert(object && object_page(object)->page_family == vm_page_family);
+    xfree(object);
+    hint = XCALLOC(1, near_other_obj_t);
+    object = XCALLOC_NEAR(hint, 1, near_obj_t);
+    assert(object && object_page(object)->page_family == vm_page_family);
+    xfree(object);
+    xfree(hint);
+    /* whatever sits in front of an out-of-band object is the previous slot's payload */
+    object = xcalloc_page_family(oob_family, 1);
+    memset(object, 0x7f, sizeof(near_obj_t));
+    hint = xcalloc_page_family(oob_family, 1);
+    assert((char *)hint == (char *)object + sizeof(near_obj_t));
+    xfree(object);
+    object = xcalloc_page_family_near(vm_page_family, hint, 1);
+    assert(object && object_page(object)->page_family == vm_page_family);
+    xfree(object);
+    xfree(hint);
+
+    for(i = 0; i < 256; i++)
+        if(i != 1)
+            xfree(objects[i]);
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
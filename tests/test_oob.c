@@ -0,0 +1,113 @@
+/* Out-of-band families: allocator bookkeeping never writes a data page (they
+ * are made read-only while objects are freed and walked), objects are 16
+ * byte aligned and one per xcalloc(), frees from other threads are drained
+ * by the owner, and empty pages go back to the kernel */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "uapi_mm.h"
+
+#define N_PAGES     5
+
+typedef struct oob_obj_{
+    uint64_t key;
+    char payload[40];
+}oob_obj_t;
+
+static oob_obj_t *objects[N_PAGES * 4096];
+static uintptr_t pages[N_PAGES * 4096];
+static int n_objects = 0;
+
+static uintptr_t page_of(void *ptr)
+{
+    return (uintptr_t)ptr & ~((uintptr_t)getpagesize() - 1);
+}
+
+static void read_cb(void *object, void *ctx)
+{
+    oob_obj_t *oob_obj = object;
+
+    assert(oob_obj->key == (uint64_t)(uintptr_t)oob_obj);
+    (*(uint64_t *)ctx)++;
+}
+
+static void protect_pages(int prot)
+{
+    int i;
+
+    for(i = 0; i < n_objects; i++)
+        if(i == 0 || pages[i] != pages[i - 1])
+            assert(mprotect((void *)pages[i], getpagesize(), prot) == 0);
+}
+
+static void test_clean_pages(vm_page_family_t *vm_page_family)
+{
+    uint64_t seen = 0U;
+    int i;
+
+    while(vm_page_family->page_count < N_PAGES){
+        objects[n_objects] = xcalloc_page_family(vm_page_family, 1);
+        assert(objects[n_objects] && (uintptr_t)objects[n_objects] % 16U == 0U);
+        objects[n_objects]->key = (uint64_t)(uintptr_t)objects[n_objects];
+        pages[n_objects] = page_of(objects[n_objects]);
+        n_objects++;
+    }
+    assert(!xcalloc_page_family(vm_page_family, 2));
+    assert(xmalloc_usable_size(objects[0]) >= sizeof(oob_obj_t));
+
+    /* free all but the first object of every page, with the pages read-only */
+    protect_pages(PROT_READ);
+    for(i = 1; i < n_objects; i++){
+        if(pages[i] == pages[i - 1]){
+            xfree(objects[i]);
+            objects[i] = NULL;
+        }
+    }
+    assert(vm_page_family->page_count == N_PAGES);
+    assert(mm_for_each_object(vm_page_family, read_cb, &seen) == N_PAGES);
+    protect_pages(PROT_READ | PROT_WRITE);
+}
+
+static void *remote_free_fn(void *arg)
+{
+    xfree(arg);
+    return NULL;
+}
+
+static void test_remote_free_and_release(vm_page_family_t *vm_page_family)
+{
+    pthread_t thread;
+    uint64_t seen = 0U;
+    int i;
+
+    for(i = 0; i < n_objects; i++){
+        if(!objects[i])
+            continue;
+        assert(pthread_create(&thread, NULL, remote_free_fn, objects[i]) == 0);
+        pthread_join(thread, NULL);
+        objects[i] = NULL;
+    }
+    /* parked until the owner's next xcalloc() */
+    assert(mm_for_each_object(vm_page_family, read_cb, &seen) == 0U);
+    objects[0] = xcalloc_page_family(vm_page_family, 1);
+    assert(objects[0] && vm_page_family->page_count == 1U);
+    xfree(objects[0]);
+    assert(vm_page_family->page_count == 0U);
+}
+
+int main(void)
+{
+    vm_page_family_t *vm_page_family = NULL;
+
+    mm_init();
+    vm_page_family = MM_REG_OOB_STRUCT(oob_obj_t);
+    assert(vm_page_family && vm_page_family->family_type == MM_PAGE_FAMILY_OUT_OF_BAND);
+    test_clean_pages(vm_page_family);
+    test_remote_free_and_release(vm_page_family);
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/* libmm_preload.so smoke test, plain libc calls run with LD_PRELOAD (see the
+ * check target): the shim is the one answering, aligned requests that fit a
+ * size class share vm pages instead of mapping one each, and the usual
+ * realloc()/calloc()/thread/fork() traffic works */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <malloc.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sys/wait.h>
+
+#define N_ALIGNED   200
+#define N_THREADS   4
+
+static void test_shim_loaded(void)
+{
+    void *ptr = malloc(100);
+
+    /* the 128 byte size class, glibc would say 104 */
+    assert(ptr && malloc_usable_size(ptr) == 128U);
+    free(ptr);
+}
+
+static void test_aligned(void)
+{
+    static const size_t alignments[] = {32, 64, 128, 256, 512, 1024, 4096, 65536};
+    void *ptrs[N_ALIGNED];
+    uintptr_t pages[N_ALIGNED];
+    int n_pages = 0;
+    size_t i, size;
+    int j, k;
+
+    for(i = 0; i < sizeof(alignments) / sizeof(alignments[0]); i++){
+        for(size = 1; size < 3000; size = size * 3 + 1){
+            assert(posix_memalign(&ptrs[0], alignments[i], size) == 0);
+            assert(((uintptr_t)ptrs[0] & (alignments[i] - 1)) == 0U);
+            assert(malloc_usable_size(ptrs[0]) >= size);
+            memset(ptrs[0], 0x5a, size);
+            free(ptrs[0]);
+        }
+    }
+    assert(posix_memalign(&ptrs[0], 24, 16) == EINVAL);
+
+    /* small aligned objects are packed into shared vm pages */
+    for(j = 0; j < N_ALIGNED; j++){
+        ptrs[j] = aligned_alloc(64, 100);
+        assert(ptrs[j] && ((uintptr_t)ptrs[j] & 63U) == 0U);
+        memset(ptrs[j], j, 100);
+        pages[j] = (uintptr_t)ptrs[j] & ~((uintptr_t)getpagesize() - 1);
+        for(k = 0; k < j && pages[k] != pages[j]; k++);
+        n_pages += k == j;
+    }
+    assert(n_pages <= N_ALIGNED / 8);
+    for(j = 0; j < N_ALIGNED; j++){
+        assert(((unsigned char *)ptrs[j])[99] == (unsigned char)j);
+        free(ptrs[j]);
+    }
+}
+
+static void test_realloc_calloc(void)
+{
+    char *ptr = malloc(10);
+    int *zeroed = NULL;
+    int i;
+
+    strcpy(ptr, "preloaded");
+    for(i = 16; i < 100000; i *= 2){
+        ptr = realloc(ptr, i);
+        assert(ptr && strcmp(ptr, "preloaded") == 0);
+    }
+    free(ptr);
+    zeroed = calloc(1000, sizeof(int));
+    for(i = 0; i < 1000; i++)
+        assert(zeroed[i] == 0);
+    free(zeroed);
+}
+
+static void *churn_fn(void *arg)
+{
+    void *ptrs[64];
+    int i, j;
+
+    (void)arg;
+    for(i = 0; i < 2000; i++){
+        for(j = 0; j < 64; j++)
+            ptrs[j] = malloc((size_t)(i + j) % 3000 + 1);
+        for(j = 0; j < 64; j++)
+            free(ptrs[j]);
+    }
+    return NULL;
+}
+
+static void test_threads_and_fork(void)
+{
+    pthread_t threads[N_THREADS];
+    int status = 0;
+    pid_t pid;
+    int i;
+
+    for(i = 0; i < N_THREADS; i++)
+        assert(pthread_create(&threads[i], NULL, churn_fn, NULL) == 0);
+    /* fork while the others allocate, the child must not find the shim locked */
+    pid = fork();
+    if(!pid){
+        free(malloc(100));
+        _exit(0);
+    }
+    for(i = 0; i < N_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main(void)
+{
+    test_shim_loaded();
+    test_aligned();
+    test_realloc_calloc();
+    test_threads_and_fork();
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
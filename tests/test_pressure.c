@@ -0,0 +1,200 @@
+/* mm_pressure_poll() driven from fake cgroup v2 (memory.current, memory.high,
+ * memory.events) and PSI files in a temporary directory. Families no live
+ * thread owns are trimmed by the poll itself, owned ones on their owner's
+ * next xcalloc() */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include <pthread.h>
+#include "uapi_mm.h"
+
+typedef struct pressure_obj_{
+    char payload[200];
+}pressure_obj_t;
+
+typedef struct pressure_cached_obj_{
+    uint64_t key;
+    char payload[56];
+}pressure_cached_obj_t;
+
+typedef struct pressure_region_obj_{
+    char payload[120];
+}pressure_region_obj_t;
+
+typedef struct pressure_reserved_obj_{
+    char payload[88];
+}pressure_reserved_obj_t;
+
+static char cgroup_dir[] = "/tmp/mm_test_pressure_XXXXXX";
+static char psi_path[sizeof(cgroup_dir) + 32];
+
+static int shrink_calls = 0;
+static mm_pressure_level_t shrink_level = MM_PRESSURE_NONE;
+
+static void shrink_cb(mm_pressure_level_t level, void *ctx)
+{
+    (void)ctx;
+    shrink_calls++;
+    shrink_level = level;
+}
+
+static void write_file(const char *name, const char *content)
+{
+    char path[sizeof(cgroup_dir) + 32];
+    FILE *fp = NULL;
+
+    snprintf(path, sizeof(path), "%s/%s", cgroup_dir, name);
+    fp = fopen(path, "w");
+    assert(fp);
+    fputs(content, fp);
+    fclose(fp);
+}
+
+static void remove_file(const char *name)
+{
+    char path[sizeof(cgroup_dir) + 32];
+
+    snprintf(path, sizeof(path), "%s/%s", cgroup_dir, name);
+    unlink(path);
+}
+
+static void write_events(unsigned high, unsigned max)
+{
+    char buf[128];
+
+    snprintf(buf, sizeof(buf), "low 0\nhigh %u\nmax %u\noom 0\noom_kill 0\n", high, max);
+    write_file("memory.events", buf);
+}
+
+static void write_psi(const char *some_avg10, const char *full_avg10)
+{
+    char buf[256];
+
+    snprintf(buf, sizeof(buf), "some avg10=%s avg60=0.00 avg300=0.00 total=0\n"
+             "full avg10=%s avg60=0.00 avg300=0.00 total=0\n", some_avg10, full_avg10);
+    write_file("memory.pressure", buf);
+}
+
+/* leaves an object cache family with its spare page behind an exited owner */
+static void *use_cache_and_exit(void *arg)
+{
+    vm_page_family_t *vm_page_family = (vm_page_family_t *)arg;
+    void *objects[32];
+    int i;
+
+    for(i = 0; i < 32; i++)
+        objects[i] = xcalloc_page_family(vm_page_family, 1);
+    for(i = 0; i < 32; i++)
+        xfree(objects[i]);
+    return NULL;
+}
+
+static void test_levels(void)
+{
+    write_file("memory.current", "100\n");
+    write_file("memory.high", "max\n");
+    write_events(0U, 0U);
+    write_psi("0.00", "0.00");
+    assert(mm_pressure_monitor_configure(cgroup_dir, psi_path));
+    assert(mm_pressure_poll() == MM_PRESSURE_NONE);
+
+    /* within 10% of memory.high, then at it */
+    write_file("memory.high", "105\n");
+    assert(mm_pressure_poll() == MM_PRESSURE_LOW);
+    assert(shrink_calls == 0);
+    write_file("memory.high", "100\n");
+    assert(mm_pressure_poll() == MM_PRESSURE_MEDIUM);
+    assert(shrink_calls == 1 && shrink_level == MM_PRESSURE_MEDIUM);
+    write_file("memory.high", "max\n");
+    assert(mm_pressure_poll() == MM_PRESSURE_NONE);
+
+    /* events count up: only a change since the last poll is pressure */
+    write_events(3U, 0U);
+    assert(mm_pressure_poll() == MM_PRESSURE_MEDIUM);
+    assert(mm_pressure_poll() == MM_PRESSURE_NONE);
+    write_events(3U, 1U);
+    assert(mm_pressure_poll() == MM_PRESSURE_CRITICAL);
+    assert(shrink_level == MM_PRESSURE_CRITICAL);
+    assert(mm_pressure_poll() == MM_PRESSURE_NONE);
+
+    write_psi("15.00", "0.00");
+    assert(mm_pressure_poll() == MM_PRESSURE_LOW);
+    write_psi("35.00", "0.00");
+    assert(mm_pressure_poll() == MM_PRESSURE_MEDIUM);
+    write_psi("0.00", "12.00");
+    assert(mm_pressure_poll() == MM_PRESSURE_CRITICAL);
+    write_psi("0.00", "0.00");
+    assert(mm_pressure_poll() == MM_PRESSURE_NONE);
+}
+
+static void test_trim(void)
+{
+    vm_page_family_t *owned = MM_REG_STRUCT(pressure_obj_t);
+    vm_page_family_t *reserved = MM_REG_STRUCT(pressure_reserved_obj_t);
+    vm_page_family_t *region = MM_REG_REGION_STRUCT(pressure_region_obj_t, 0U);
+    vm_page_family_t *cache = MM_REG_STRUCT_CTOR(pressure_cached_obj_t, NULL, NULL);
+    pthread_t thread;
+    void *object = NULL;
+    uint32_t owned_pages = 0U;
+
+    /* owned by this thread, with reserved empty pages */
+    mm_reserve(owned, 200U);
+    object = xcalloc_page_family(owned, 1);
+    xfree(object);
+    owned_pages = owned->page_count;
+    assert(owned_pages > 1U);
+    /* reserved but never allocated from */
+    assert(mm_reserve(reserved, 200U) > 1U);
+    /* warm region pages, nobody allocating */
+    assert(mm_reserve(region, 200U) > 1U);
+    /* orphaned object cache keeping its spare page */
+    pthread_create(&thread, NULL, use_cache_and_exit, cache);
+    pthread_join(thread, NULL);
+    assert(cache->page_count == 1U);
+
+    /* MEDIUM: warm pages and cache spares go, right from the poll */
+    write_file("memory.high", "100\n");
+    assert(mm_pressure_poll() == MM_PRESSURE_MEDIUM);
+    assert(region->page_count == 0U);
+    assert(cache->page_count == 0U);
+    assert(reserved->page_count > 1U);
+    assert(owned->page_count == owned_pages);
+
+    /* CRITICAL: reserved pages too, except where a live owner has to do it */
+    write_file("memory.high", "max\n");
+    write_events(4U, 2U);
+    assert(mm_pressure_poll() == MM_PRESSURE_CRITICAL);
+    assert(reserved->page_count == 0U);
+    assert(owned->page_count == owned_pages);
+
+    object = xcalloc_page_family(owned, 1);
+    assert(owned->page_count == 1U);
+    xfree(object);
+}
+
+int main(void)
+{
+    mm_init();
+    assert(mkdtemp(cgroup_dir));
+    snprintf(psi_path, sizeof(psi_path), "%s/memory.pressure", cgroup_dir);
+    assert(mm_register_shrink_callback(shrink_cb, NULL));
+
+    assert(mm_pressure_poll() == MM_PRESSURE_NONE);
+    test_levels();
+    test_trim();
+
+    assert(mm_pressure_monitor_configure(NULL, NULL));
+    write_file("memory.high", "100\n");
+    assert(mm_pressure_poll() == MM_PRESSURE_NONE);
+
+    remove_file("memory.current");
+    remove_file("memory.high");
+    remove_file("memory.events");
+    remove_file("memory.pressure");
+    rmdir(cgroup_dir);
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
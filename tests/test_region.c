@@ -0,0 +1,114 @@
+/* Region families: odd sized objects keep max_align_t alignment, a reset
+ * keeps up to warm_pages pages for the next round, and a pressure callback
+ * may reset the region it was called for */
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "uapi_mm.h"
+
+typedef struct region_odd_obj_{
+    char payload[13];
+}region_odd_obj_t;
+
+typedef struct region_obj_{
+    char payload[120];
+}region_obj_t;
+
+static int reset_calls = 0;
+
+static void count_cb(void *object, void *ctx)
+{
+    (void)object;
+    (*(uint64_t *)ctx)++;
+}
+
+static void test_alignment(void)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_region_family("region_odd_obj_t",
+                                            sizeof(region_odd_obj_t), 0U);
+    char *objects[512];
+    int units[512];
+    int i, j;
+
+    for(i = 0; i < 512; i++){
+        units[i] = 1 + i % 3;
+        objects[i] = xcalloc_page_family(vm_page_family, units[i]);
+        assert(objects[i]);
+        assert((uintptr_t)objects[i] % _Alignof(max_align_t) == 0U);
+        memset(objects[i], i & 0xff, units[i] * sizeof(region_odd_obj_t));
+    }
+    /* rounding up never made two objects overlap */
+    for(i = 0; i < 512; i++)
+        for(j = 0; j < units[i] * (int)sizeof(region_odd_obj_t); j++)
+            assert(objects[i][j] == (char)(i & 0xff));
+    mm_region_reset(vm_page_family);
+    assert(vm_page_family->page_count == 0U);
+}
+
+static void test_reset_and_warm_pages(void)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_region_family("region_obj_t",
+                                            sizeof(region_obj_t), 2U);
+    uint64_t seen = 0U;
+    int n = 0;
+
+    while(vm_page_family->page_count < 4U){
+        assert(XCALLOC(1, region_obj_t));
+        n++;
+    }
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == (uint64_t)n);
+    /* xfree() leaves region objects alone */
+    xfree(XCALLOC(1, region_obj_t));
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == (uint64_t)n + 1U);
+
+    mm_region_reset(vm_page_family);
+    assert(vm_page_family->page_count == 2U && vm_page_family->region_free_page_count == 2U);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == 0U);
+
+    /* the next round starts on the warm pages */
+    for(n = 0; vm_page_family->region_free_page_count; n++)
+        assert(XCALLOC(1, region_obj_t));
+    assert(vm_page_family->page_count == 2U);
+    mm_region_reset(vm_page_family);
+    assert(vm_page_family->page_count == 2U);
+
+    mm_region_set_warm_pages(vm_page_family, 0U);
+    mm_region_reset(vm_page_family);
+    assert(vm_page_family->page_count == 0U);
+}
+
+/* called from xcalloc() with the family short of room */
+static void reset_cb(vm_page_family_t *vm_page_family, void *ctx)
+{
+    (void)ctx;
+    reset_calls++;
+    mm_region_reset(vm_page_family);
+}
+
+static void test_callback_resets(void)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_region_family("region_cb_obj_t",
+                                            sizeof(region_obj_t), 1U);
+    int i;
+
+    mm_set_page_family_memory_limits(vm_page_family, getpagesize(), 0U);
+    mm_register_pressure_callback(vm_page_family, reset_cb, NULL);
+    for(i = 0; i < 1000; i++)
+        assert(xcalloc_page_family(vm_page_family, 1));
+    /* every full page was reset and reused instead of growing the region */
+    assert(reset_calls > 0);
+    assert(vm_page_family->page_count == 1U);
+}
+
+int main(void)
+{
+    mm_init();
+    test_alignment();
+    test_reset_and_warm_pages();
+    test_callback_resets();
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
@@ -0,0 +1,73 @@
+/* Family registry: a big registration table and lookups by name through the
+ * name hash, and vm pages that are only populated up front for mm_reserve() */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+#include <sys/mman.h>
+#include "uapi_mm.h"
+
+#define N_FAMILIES  5000U
+
+static mm_page_family_reg_t table[N_FAMILIES];
+static char names[N_FAMILIES][MM_MAX_STRUCT_NAME];
+static vm_page_family_t *families[N_FAMILIES];
+
+/* system pages of [address, address + n_pages) that are resident */
+static uint32_t resident_pages(void *address, uint32_t n_pages)
+{
+    unsigned char residency[MM_MAX_PAGE_SPAN];
+    uint32_t resident = 0U;
+    uint32_t i;
+
+    assert(n_pages <= MM_MAX_PAGE_SPAN);
+    assert(mincore(address, n_pages * getpagesize(), residency) == 0);
+    for(i = 0U; i < n_pages; i++)
+        resident += residency[i] & 1U;
+    return resident;
+}
+
+static void test_register_table(void)
+{
+    uint32_t i;
+
+    for(i = 0U; i < N_FAMILIES; i++){
+        snprintf(names[i], sizeof(names[i]), "registry_obj_%u_t", i);
+        table[i].struct_name = names[i];
+        table[i].struct_size = 16U + i % 512U;
+        table[i].reserve_objects = 0U;
+        table[i].page_family = &families[i];
+    }
+    assert(mm_register_page_families(table, N_FAMILIES) == N_FAMILIES);
+    for(i = 0U; i < N_FAMILIES; i++){
+        assert(families[i] && mm_lookup_page_family_by_name(names[i]) == families[i]);
+        assert(families[i]->struct_size == 16U + i % 512U);
+    }
+    assert(!mm_lookup_page_family_by_name("registry_obj_unknown_t"));
+    assert(xcalloc(names[N_FAMILIES - 1], 1));
+}
+
+static void test_populate_on_reserve_only(void)
+{
+    /* 2100 bytes get a multi page span, the first object only touches its first page */
+    vm_page_family_t *lazy = mm_instantiate_new_page_family("registry_lazy_obj_t", 2100U);
+    vm_page_family_t *reserved = mm_instantiate_new_page_family("registry_reserved_obj_t", 2100U);
+    uint32_t span = lazy->page_span;
+
+    assert(span > 2U);
+    assert(xcalloc_page_family(lazy, 1));
+    assert(resident_pages(lazy->first_page, span) < span);
+
+    assert(mm_reserve(reserved, 1U) == 1U);
+    assert(resident_pages(reserved->first_page, span) == span);
+}
+
+int main(void)
+{
+    mm_init();
+    test_register_table();
+    test_populate_on_reserve_only();
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
@@ -0,0 +1,120 @@
+/* Blocks xfree()d by a thread other than the family owner wait on the remote
+ * free stack; walkers and mm_print_block_usage() must see them as free */
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include "uapi_mm.h"
+
+#define N_OBJECTS   64
+
+typedef struct remote_obj_{
+    char name[40];
+    uint32_t id;
+}remote_obj_t;
+
+typedef struct remote_cached_obj_{
+    uint64_t key;
+    uint64_t value;
+}remote_cached_obj_t;
+
+typedef struct remote_orphan_obj_{
+    uint32_t id;
+    char name[60];
+}remote_orphan_obj_t;
+
+static void *objects[N_OBJECTS];
+
+static void *free_odd_objects(void *arg)
+{
+    int i;
+
+    (void)arg;
+    for(i = 1; i < N_OBJECTS; i += 2)
+        xfree(objects[i]);
+    return NULL;
+}
+
+static void count_cb(void *object, void *ctx)
+{
+    (void)object;
+    (*(uint64_t *)ctx)++;
+}
+
+static void free_half_from_other_thread(vm_page_family_t *vm_page_family)
+{
+    pthread_t thread;
+    uint64_t seen = 0U;
+    int i;
+
+    mm_page_family_bind_owner(vm_page_family);
+    for(i = 0; i < N_OBJECTS; i++)
+        objects[i] = xcalloc_page_family(vm_page_family, 1);
+    pthread_create(&thread, NULL, free_odd_objects, NULL);
+    pthread_join(thread, NULL);
+
+    /* nothing drained yet, the frees are only pending */
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == N_OBJECTS / 2);
+    assert(seen == N_OBJECTS / 2);
+    assert(mm_parallel_for_each_object(vm_page_family, count_cb, &seen, 2U) == N_OBJECTS / 2);
+    mm_print_block_usage();
+
+    /* out-of-band walkers drain on the owner's behalf, the others leave it to us */
+    mm_drain_remote_frees(vm_page_family);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == N_OBJECTS / 2);
+    mm_print_block_usage();
+
+    for(i = 0; i < N_OBJECTS; i += 2)
+        xfree(objects[i]);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == 0U);
+}
+
+static void *allocate_and_exit(void *arg)
+{
+    vm_page_family_t *vm_page_family = (vm_page_family_t *)arg;
+    int i;
+
+    for(i = 0; i < N_OBJECTS; i++)
+        objects[i] = xcalloc_page_family(vm_page_family, 1);
+    return NULL;
+}
+
+/* The owner exits with objects still out: the family is unbound, frees from
+ * the survivors are drained by the maintenance pass, the next allocating
+ * thread adopts it */
+static void owner_exits(vm_page_family_t *vm_page_family)
+{
+    pthread_t thread;
+    uint64_t seen = 0U;
+    int i;
+
+    pthread_create(&thread, NULL, allocate_and_exit, vm_page_family);
+    pthread_join(thread, NULL);
+    for(i = 1; i < N_OBJECTS; i += 2)
+        xfree(objects[i]);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == N_OBJECTS / 2);
+    mm_print_block_usage();
+
+    mm_maintenance_run_once();
+    assert(mm_drain_remote_frees(vm_page_family) == 0U);
+
+    objects[1] = xcalloc_page_family(vm_page_family, 1);
+    assert(objects[1]);
+    for(i = 0; i < N_OBJECTS; i += 2)
+        xfree(objects[i]);
+    xfree(objects[1]);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == 0U);
+    mm_print_block_usage();
+}
+
+int main(void)
+{
+    mm_init();
+    free_half_from_other_thread(MM_REG_STRUCT(remote_obj_t));
+    free_half_from_other_thread(MM_REG_STRUCT_CTOR(remote_cached_obj_t, NULL, NULL));
+    free_half_from_other_thread(mm_instantiate_new_oob_family("remote_obj_t_oob", sizeof(remote_obj_t)));
+    owner_exits(MM_REG_STRUCT(remote_orphan_obj_t));
+    owner_exits(mm_instantiate_new_oob_family("remote_orphan_obj_t_oob", sizeof(remote_orphan_obj_t)));
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
@@ -0,0 +1,133 @@
+/* Allocation traces: every kind of family is described by its REGISTER
+ * record (a sharded family under its own id, not its shards'), and
+ * mm_replay.bin replays the trace against the manager and against glibc
+ * with the same operation counts, region xfree()s left to the reset */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "uapi_mm.h"
+#include "mm_trace.h"
+
+#define TRACE_PATH  "/tmp/test_replay.trace"
+
+typedef struct replay_obj_{
+    char payload[40];
+}replay_obj_t;
+
+static vm_page_family_t *families[5];
+static vm_page_family_type_t traced_types[5];
+
+static void record_trace(void)
+{
+    void *objects[100];
+    void *huge[2];
+    int i;
+
+    families[0] = mm_instantiate_new_page_family("replay_general_t", sizeof(replay_obj_t));
+    families[1] = mm_instantiate_new_region_family("replay_region_t", sizeof(replay_obj_t), 0U);
+    families[2] = mm_instantiate_new_cache_family("replay_cache_t", sizeof(replay_obj_t), NULL, NULL);
+    families[3] = mm_instantiate_new_oob_family("replay_oob_t", sizeof(replay_obj_t));
+    families[4] = mm_instantiate_new_sharded_family("replay_sharded_t", sizeof(replay_obj_t), 2U);
+
+    assert(mm_trace_start(TRACE_PATH));
+    for(i = 0; i < 100; i++)
+        objects[i] = xcalloc_page_family(families[0], 1);
+    for(i = 0; i < 60; i++)
+        xfree(objects[i]);
+    for(i = 0; i < 50; i++)
+        objects[i] = xcalloc_page_family(families[1], 2);
+    for(i = 0; i < 10; i++)
+        xfree(objects[i]);
+    mm_region_reset(families[1]);
+    for(i = 0; i < 20; i++)
+        objects[i] = xcalloc_page_family(families[2], 1);
+    for(i = 0; i < 20; i++)
+        xfree(objects[i]);
+    for(i = 0; i < 30; i++)
+        objects[i] = xcalloc_page_family(families[3], 1);
+    for(i = 0; i < 30; i++)
+        xfree(objects[i]);
+    for(i = 0; i < 40; i++)
+        objects[i] = xcalloc_page_family(families[4], 1);
+    for(i = 0; i < 40; i++)
+        xfree(objects[i]);
+    for(i = 0; i < 2; i++)
+        huge[i] = xmalloc(100000);
+    for(i = 0; i < 2; i++)
+        xfree(huge[i]);
+    mm_trace_stop();
+}
+
+static void check_trace(void)
+{
+    mm_trace_file_header_t header;
+    mm_trace_record_t record;
+    FILE *fp = fopen(TRACE_PATH, "rb");
+    int n_registers = 0;
+    int i;
+
+    assert(fp && fread(&header, sizeof(header), 1, fp) == 1);
+    assert(!memcmp(header.magic, MM_TRACE_MAGIC, sizeof(header.magic)));
+    while(fread(&record, sizeof(record), 1, fp) == 1){
+        if(record.op != MM_TRACE_OP_REGISTER)
+            continue;
+        n_registers++;
+        for(i = 0; i < 5 && families[i]->family_id != record.family_id; i++);
+        assert(i < 5 && record.units == sizeof(replay_obj_t));
+        traced_types[i] = (vm_page_family_type_t)record.object_id;
+    }
+    fclose(fp);
+    assert(n_registers == 5);
+    for(i = 0; i < 5; i++)
+        assert(traced_types[i] == families[i]->family_type);
+    assert(traced_types[4] == MM_PAGE_FAMILY_SHARDED);
+}
+
+/* the value after "<label> :" in mm_replay.bin's report */
+static uint64_t report_value(const char *report, const char *label)
+{
+    const char *line = strstr(report, label);
+
+    assert(line);
+    line = strchr(line, ':');
+    assert(line);
+    return strtoull(line + 1, NULL, 10);
+}
+
+static void replay(const char *args)
+{
+    char command[256];
+    char report[4096];
+    size_t n;
+    FILE *fp = NULL;
+
+    snprintf(command, sizeof(command), "./mm_replay.bin %s %s", TRACE_PATH, args);
+    fp = popen(command, "r");
+    assert(fp);
+    n = fread(report, 1, sizeof(report) - 1U, fp);
+    report[n] = '\0';
+    assert(pclose(fp) == 0);
+
+    assert(report_value(report, "Allocations") == 242U);
+    assert(strstr(report, "(0 failed)"));
+    assert(report_value(report, "Frees") == 152U);
+    assert(strstr(report, "(0 not matched in trace)"));
+    assert(report_value(report, "Region frees") == 10U);
+    assert(report_value(report, "Region resets") == 1U);
+    assert(strstr(report, "Peak RSS growth"));
+}
+
+int main(void)
+{
+    mm_init();
+    record_trace();
+    check_trace();
+    replay("");
+    replay("--glibc");
+    unlink(TRACE_PATH);
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
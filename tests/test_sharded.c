@@ -0,0 +1,215 @@
+/* Sharded families: stealing from other shards before mapping a new vm page,
+ * xfree() from another CPU returning blocks to the shard that owns them,
+ * walking the family while another thread allocates from it, limits set on
+ * the family covering all shards, and callbacks freeing into the family */
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "uapi_mm.h"
+
+#define N_SHARDS        4U
+#define N_CHURN_LIVE    64
+
+typedef struct sharded_obj_{
+    uint64_t key;
+    char payload[120];
+}sharded_obj_t;
+
+static void *objects[4096];
+static uint32_t n_objects = 0U;
+static vm_bool_t churn_stop = MM_FALSE;
+
+static vm_page_family_t *object_shard(void *object)
+{
+    block_meta_data_t *block_meta_data = (block_meta_data_t *)object - 1;
+
+    return ((vm_page_t *)MM_GET_PAGE_FROM_META_BLOCK(block_meta_data))->page_family;
+}
+
+static uint32_t total_pages(vm_page_family_t *vm_page_family)
+{
+    uint32_t pages = 0U;
+    uint32_t i;
+
+    for(i = 0U; i < vm_page_family->shard_count; i++)
+        pages += vm_page_family->shards[i]->page_count;
+    return pages;
+}
+
+static void count_cb(void *object, void *ctx)
+{
+    (void)object;
+    (*(uint64_t *)ctx)++;
+}
+
+static void *free_all(void *arg)
+{
+    uint32_t i;
+
+    (void)arg;
+    for(i = 0U; i < n_objects; i++)
+        xfree(objects[i]);
+    return NULL;
+}
+
+static void *churn(void *arg)
+{
+    vm_page_family_t *vm_page_family = (vm_page_family_t *)arg;
+    void *live[N_CHURN_LIVE] = {NULL};
+    uint32_t i = 0U;
+
+    while(!__atomic_load_n(&churn_stop, __ATOMIC_RELAXED)){
+        if(live[i % N_CHURN_LIVE])
+            xfree(live[i % N_CHURN_LIVE]);
+        live[i % N_CHURN_LIVE] = xcalloc_page_family(vm_page_family, 1 + i % 3);
+        i++;
+    }
+    for(i = 0U; i < N_CHURN_LIVE; i++)
+        if(live[i])
+            xfree(live[i]);
+    return NULL;
+}
+
+static void test_steal_and_remote_cpu_free(void)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_sharded_family("sharded_obj_t",
+                                            sizeof(sharded_obj_t), N_SHARDS);
+    vm_page_family_t *used_shards[N_SHARDS];
+    uint32_t n_used_shards = 0U;
+    uint32_t reserved_pages = 0U;
+    uint64_t seen = 0U;
+    pthread_t thread;
+    uint32_t i, j;
+
+    assert(vm_page_family && vm_page_family->shard_count == N_SHARDS);
+    reserved_pages = mm_reserve(vm_page_family, 1024U);
+    assert(reserved_pages == total_pages(vm_page_family));
+    for(i = 0U; i < N_SHARDS; i++)
+        assert(vm_page_family->shards[i]->page_count > 0U);
+
+    /* more than one shard holds, all from the calling CPU: the home shard
+     * runs dry and the rest come from the other shards' reserved pages */
+    for(n_objects = 0U; n_objects < 1024U; n_objects++){
+        objects[n_objects] = XCALLOC(1, sharded_obj_t);
+        assert(objects[n_objects]);
+        assert(object_shard(objects[n_objects])->shard_parent == vm_page_family);
+    }
+    assert(total_pages(vm_page_family) == reserved_pages);
+    for(i = 0U; i < n_objects; i++){
+        for(j = 0U; j < n_used_shards && used_shards[j] != object_shard(objects[i]); j++);
+        if(j == n_used_shards)
+            used_shards[n_used_shards++] = object_shard(objects[i]);
+    }
+    assert(n_used_shards == N_SHARDS);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == n_objects);
+
+    /* freed from another thread, each block goes back to its own shard: a
+     * shard whose pages are all free again has one free block per page */
+    pthread_create(&thread, NULL, free_all, NULL);
+    pthread_join(thread, NULL);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == 0U);
+    assert(total_pages(vm_page_family) == reserved_pages);
+    for(i = 0U; i < N_SHARDS; i++){
+        assert(glthread_list_count(&vm_page_family->shards[i]->free_block_priority_list_head) ==
+               vm_page_family->shards[i]->page_count);
+    }
+    mm_print_block_usage();
+}
+
+static void test_walk_while_allocating(void)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_sharded_family("sharded_churn_obj_t",
+                                            sizeof(sharded_obj_t), N_SHARDS);
+    pthread_t thread;
+    uint64_t seen = 0U;
+    int n;
+
+    pthread_create(&thread, NULL, churn, vm_page_family);
+    for(n = 0; n < 2000; n++){
+        /* at most N_CHURN_LIVE blocks of up to 3 objects each */
+        assert(mm_for_each_object(vm_page_family, count_cb, &seen) <= N_CHURN_LIVE * 3U);
+        if(n % 100 == 0)
+            mm_print_block_usage();
+    }
+    __atomic_store_n(&churn_stop, MM_TRUE, __ATOMIC_RELAXED);
+    pthread_join(thread, NULL);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == 0U);
+}
+
+static uint32_t pressure_calls = 0U;
+static uint32_t pressure_frees = 0U;
+
+/* runs from xcalloc(): frees into the very shard that is short of room */
+static void release_cb(vm_page_family_t *vm_page_family, void *ctx)
+{
+    (void)ctx;
+    pressure_calls++;
+    assert(vm_page_family->family_type == MM_PAGE_FAMILY_SHARDED);
+    if(pressure_frees < 8U && n_objects){
+        xfree(objects[--n_objects]);
+        pressure_frees++;
+    }
+}
+
+static void test_limits_and_callbacks(void)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_sharded_family("sharded_limit_obj_t",
+                                            sizeof(sharded_obj_t), N_SHARDS);
+    void *object = NULL;
+
+    mm_set_page_family_memory_limits(vm_page_family, getpagesize(), 3U * getpagesize());
+    mm_register_pressure_callback(vm_page_family, release_cb, NULL);
+
+    for(n_objects = 0U; n_objects < 4096U; n_objects++){
+        object = xcalloc_page_family(vm_page_family, 1);
+        if(!object)
+            break;
+        objects[n_objects] = object;
+    }
+    /* the hard limit stopped the family as a whole, not shard by shard */
+    assert(n_objects < 4096U);
+    assert(total_pages(vm_page_family) == 3U);
+    assert(vm_page_family->page_count == total_pages(vm_page_family));
+    /* past the soft limit the callback was asked first, with no shard lock held */
+    assert(pressure_calls > 0U && pressure_frees == 8U);
+
+    free_all(NULL);
+    assert(vm_page_family->page_count == total_pages(vm_page_family));
+}
+
+/* frees every object it visits back into the family being walked */
+static void free_cb(void *object, void *ctx)
+{
+    (void)ctx;
+    xfree(object);
+}
+
+static void test_walker_frees(void)
+{
+    vm_page_family_t *vm_page_family = mm_instantiate_new_sharded_family("sharded_walk_obj_t",
+                                            sizeof(sharded_obj_t), N_SHARDS);
+    uint64_t seen = 0U;
+
+    for(n_objects = 0U; n_objects < 512U; n_objects++)
+        objects[n_objects] = xcalloc_page_family(vm_page_family, 1);
+    assert(mm_for_each_object(vm_page_family, free_cb, NULL) == 512U);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == 0U);
+
+    for(n_objects = 0U; n_objects < 512U; n_objects++)
+        objects[n_objects] = xcalloc_page_family(vm_page_family, 1);
+    assert(mm_parallel_for_each_object(vm_page_family, free_cb, NULL, 4U) == 512U);
+    assert(mm_for_each_object(vm_page_family, count_cb, &seen) == 0U);
+}
+
+int main(void)
+{
+    mm_init();
+    test_steal_and_remote_cpu_free();
+    test_walk_while_allocating();
+    test_limits_and_callbacks();
+    test_walker_frees();
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
@@ -0,0 +1,125 @@
+/* Allocation tags: objects charged on one thread and credited on another
+ * add up across the per-thread counts, counts of exited threads stay in the
+ * totals, and with remote frees off the shared counters do the work */
+#include <stdio.h>
+#include <stdint.h>
+#include <assert.h>
+#include <pthread.h>
+#include "uapi_mm.h"
+
+#define N_THREADS   4
+#define N_OBJECTS   1000
+#define N_EXITING   200
+
+typedef struct tags_obj_{
+    char payload[64];
+}tags_obj_t;
+
+static vm_page_family_t *families[N_THREADS];
+static void *objects[N_THREADS][N_OBJECTS];
+static void *exited_objects[N_EXITING];
+static pthread_barrier_t barrier;
+
+static void check_tag(mm_tag_t tag, uint64_t n_objects)
+{
+    mm_tag_stats_t stats;
+
+    mm_get_tag_stats(tag, &stats);
+    assert(stats.live_objects == n_objects);
+    assert(stats.live_bytes == n_objects * sizeof(tags_obj_t));
+}
+
+/* thread i charges tag 10 + i for its objects, then frees its neighbour's */
+static void *charge_credit_fn(void *arg)
+{
+    int i = (int)(intptr_t)arg;
+    int neighbour = (i + 1) % N_THREADS;
+    int j;
+
+    mm_set_current_tag(10U + i);
+    for(j = 0; j < N_OBJECTS; j++)
+        assert((objects[i][j] = xcalloc_page_family(families[i], 1)));
+    pthread_barrier_wait(&barrier);
+    pthread_barrier_wait(&barrier);
+    for(j = 0; j < N_OBJECTS; j++)
+        xfree(objects[neighbour][j]);
+    return NULL;
+}
+
+static void test_cross_thread(void)
+{
+    pthread_t threads[N_THREADS];
+    char struct_name[MM_MAX_STRUCT_NAME];
+    intptr_t i;
+
+    for(i = 0; i < N_THREADS; i++){
+        snprintf(struct_name, sizeof(struct_name), "tags_obj_%ld_t", (long)i);
+        families[i] = mm_instantiate_new_page_family(struct_name, sizeof(tags_obj_t));
+    }
+    pthread_barrier_init(&barrier, NULL, N_THREADS + 1);
+    for(i = 0; i < N_THREADS; i++)
+        assert(pthread_create(&threads[i], NULL, charge_credit_fn, (void *)i) == 0);
+    /* everything charged, nothing credited yet */
+    pthread_barrier_wait(&barrier);
+    for(i = 0; i < N_THREADS; i++)
+        check_tag(10U + i, N_OBJECTS);
+    check_tag(MM_TAG_UNTAGGED, 0U);
+    pthread_barrier_wait(&barrier);
+    for(i = 0; i < N_THREADS; i++)
+        pthread_join(threads[i], NULL);
+    pthread_barrier_destroy(&barrier);
+    for(i = 0; i < N_THREADS; i++)
+        check_tag(10U + i, 0U);
+}
+
+static void *exiting_fn(void *arg)
+{
+    intptr_t i = (intptr_t)arg;
+
+    exited_objects[i] = xcalloc_tagged("tags_obj_0_t", 1, 20U);
+    assert(exited_objects[i]);
+    return NULL;
+}
+
+/* one thread after the other, each leaves its object and its count behind */
+static void test_exited_threads(void)
+{
+    pthread_t thread;
+    intptr_t i;
+
+    for(i = 0; i < N_EXITING; i++){
+        assert(pthread_create(&thread, NULL, exiting_fn, (void *)i) == 0);
+        pthread_join(thread, NULL);
+    }
+    check_tag(20U, N_EXITING);
+    for(i = 0; i < N_EXITING; i++)
+        xfree(exited_objects[i]);
+    check_tag(20U, 0U);
+}
+
+static void test_shared_counters(void)
+{
+    pthread_t thread;
+    intptr_t i;
+
+    mm_set_remote_free_mode(MM_FALSE);
+    for(i = 0; i < N_EXITING; i++){
+        assert(pthread_create(&thread, NULL, exiting_fn, (void *)i) == 0);
+        pthread_join(thread, NULL);
+    }
+    check_tag(20U, N_EXITING);
+    for(i = 0; i < N_EXITING; i++)
+        xfree(exited_objects[i]);
+    check_tag(20U, 0U);
+    mm_set_remote_free_mode(MM_TRUE);
+}
+
+int main(void)
+{
+    mm_init();
+    test_cross_thread();
+    test_exited_threads();
+    test_shared_counters();
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
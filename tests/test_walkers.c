@@ -0,0 +1,104 @@
+/* mm_parallel_for_each_object(): every live object of a family is visited
+ * exactly once whatever the worker count, free and freed blocks are skipped,
+ * multi unit blocks and multi page spans included, and the count matches the
+ * sequential walker */
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "uapi_mm.h"
+
+#define N_OBJECTS   5000
+
+typedef struct walker_obj_{
+    uint32_t visits;
+    uint32_t live;
+    char payload[88];
+}walker_obj_t;
+
+typedef struct walker_big_obj_{
+    uint32_t visits;
+    uint32_t live;
+    char payload[2092];
+}walker_big_obj_t;
+
+static void *objects[N_OBJECTS];
+static int units[N_OBJECTS];
+
+static void visit_cb(void *object, void *ctx)
+{
+    walker_obj_t *walker_obj = object;
+
+    (void)ctx;
+    assert(walker_obj->live);
+    __atomic_add_fetch(&walker_obj->visits, 1U, __ATOMIC_RELAXED);
+}
+
+/* each live object seen once per walk, its other units never */
+static uint64_t check_visits(vm_page_family_t *vm_page_family, uint32_t struct_size, uint32_t n_workers)
+{
+    uint64_t expected = 0U;
+    uint64_t visited = 0U;
+    int i, j;
+
+    for(i = 0; i < N_OBJECTS; i++)
+        if(objects[i])
+            for(j = 0; j < units[i]; j++)
+                ((walker_obj_t *)((char *)objects[i] + j * struct_size))->visits = 0U;
+    visited = n_workers ? mm_parallel_for_each_object(vm_page_family, visit_cb, NULL, n_workers) :
+                          mm_for_each_object(vm_page_family, visit_cb, NULL);
+    for(i = 0; i < N_OBJECTS; i++){
+        if(!objects[i])
+            continue;
+        for(j = 0; j < units[i]; j++)
+            assert(((walker_obj_t *)((char *)objects[i] + j * struct_size))->visits == 1U);
+        expected += units[i];
+    }
+    assert(visited == expected);
+    return visited;
+}
+
+static void check_family(vm_page_family_t *vm_page_family, uint32_t struct_size, int max_units)
+{
+    static const uint32_t workers[] = {1U, 2U, 3U, 4U, 16U, 1000U};
+    uint64_t sequential = 0U;
+    uint32_t i;
+    int j, k;
+
+    memset(objects, 0, sizeof(objects));
+    for(j = 0; j < N_OBJECTS; j++){
+        units[j] = 1 + j % max_units;
+        objects[j] = xcalloc_page_family(vm_page_family, units[j]);
+        assert(objects[j]);
+        for(k = 0; k < units[j]; k++)
+            ((walker_obj_t *)((char *)objects[j] + k * struct_size))->live = 1U;
+    }
+    /* holes everywhere, and whole pages emptied out */
+    for(j = 0; j < N_OBJECTS; j++){
+        if(j % 3 == 0 || (j / 200) % 4 == 1){
+            xfree(objects[j]);
+            objects[j] = NULL;
+        }
+    }
+    sequential = check_visits(vm_page_family, struct_size, 0U);
+    for(i = 0U; i < sizeof(workers) / sizeof(workers[0]); i++)
+        assert(check_visits(vm_page_family, struct_size, workers[i]) == sequential);
+
+    for(j = 0; j < N_OBJECTS; j++)
+        if(objects[j])
+            xfree(objects[j]);
+    memset(objects, 0, sizeof(objects));
+    assert(mm_parallel_for_each_object(vm_page_family, visit_cb, NULL, 4U) == 0U);
+}
+
+int main(void)
+{
+    mm_init();
+    check_family(MM_REG_STRUCT(walker_obj_t), sizeof(walker_obj_t), 3);
+    /* spans of several system pages */
+    check_family(MM_REG_STRUCT(walker_big_obj_t), sizeof(walker_big_obj_t), 1);
+    check_family(mm_instantiate_new_sharded_family("walker_sharded_obj_t", sizeof(walker_obj_t), 3U),
+                 sizeof(walker_obj_t), 2);
+    printf("%s: PASS\n", __FILE__);
+    return 0;
+}
@@ -1,24 +1,217 @@
 #ifndef _UAPI_MM_H_
 #define _UAPI_MM_H_
 
+#include <stddef.h>
 #include "mm.h"
 
+#ifdef __cplusplus
+extern "C" {
+#endif
+
 /* Function Prototypes */
 void mm_init(void);
-void mm_instantiate_new_page_family(char *struct_name, uint32_t struct_size);
+vm_page_family_t *mm_instantiate_new_page_family(char *struct_name, uint32_t struct_size);
 void mm_print_registered_page_families(void);
 void mm_print_memory_usage(char *struct_name);
 void mm_print_block_usage(void);
+/* Span (system pages per vm page) chosen for each family and the expected
+ * utilization for single object allocations */
+void mm_print_page_family_spans(void);
 
 void *xcalloc(char *struct_name, int units);
 void xfree(void *ptr);
 
+/* Allocate straight from an already looked up family, skipping the name lookup */
+void *xcalloc_page_family(vm_page_family_t *vm_page_family, int units);
+uint32_t mm_page_family_max_units(vm_page_family_t *vm_page_family);
+
+/* Prefer free space on the same vm page as hint_ptr (a live object), then the
+ * pages on either side of it on the family's page list (not its neighbours in
+ * the address space), so linked structures stay within a few pages. NULL
+ * hint, or one from another family, behaves like xcalloc() */
+void *xcalloc_near(void *hint_ptr, char *struct_name, int units);
+void *xcalloc_page_family_near(vm_page_family_t *vm_page_family, void *hint_ptr, int units);
+
+/* Cross thread frees: the owner drains them on its next allocation, or
+ * explicitly from its own maintenance pass. Unbinding (done for the owner when
+ * it exits) orphans the family: frees stay deferred, any thread may drain
+ * them and the maintenance thread does, until a thread allocates and adopts it */
+void mm_page_family_bind_owner(vm_page_family_t *vm_page_family);
+void mm_page_family_unbind_owner(vm_page_family_t *vm_page_family);
+uint32_t mm_drain_remote_frees(vm_page_family_t *vm_page_family);
+
+/* Memory limits, in bytes, rounded up to whole vm pages. 0 means unlimited.
+ * Going past the soft limit invokes the pressure callbacks, the hard limit
+ * makes xcalloc() fail */
+vm_page_family_t *mm_instantiate_new_page_family_with_limits(char *struct_name, uint32_t struct_size,
+    uint64_t soft_limit_bytes, uint64_t hard_limit_bytes);
+void mm_set_page_family_memory_limits(vm_page_family_t *vm_page_family,
+    uint64_t soft_limit_bytes, uint64_t hard_limit_bytes);
+void mm_register_pressure_callback(vm_page_family_t *vm_page_family, mm_pressure_cb_t cb, void *ctx);
+void mm_set_global_memory_limits(uint64_t soft_limit_bytes, uint64_t hard_limit_bytes);
+void mm_register_global_pressure_callback(mm_pressure_cb_t cb, void *ctx);
+uint32_t mm_get_total_vm_page_count(void);
+
+/* Region families: xcalloc() bumps a pointer through the current vm page,
+ * xfree() does nothing and mm_region_reset() drops every object at once,
+ * keeping up to warm_pages pages mapped for the next round */
+vm_page_family_t *mm_instantiate_new_region_family(char *struct_name, uint32_t struct_size,
+    uint32_t warm_pages);
+void mm_region_set_warm_pages(vm_page_family_t *vm_page_family, uint32_t warm_pages);
+void mm_region_reset(vm_page_family_t *vm_page_family);
+
+/* Object cache families: slots are built by ctor when their vm page is
+ * populated and xfree() hands them back as they are, so xcalloc() returns a
+ * constructed (not zeroed) object, one at a time. dtor runs only when an
+ * empty vm page is given back to the kernel */
+vm_page_family_t *mm_instantiate_new_cache_family(char *struct_name, uint32_t struct_size,
+    mm_object_ctor_t ctor, mm_object_dtor_t dtor);
+
+/* Out-of-band families: block state lives in a separate dense table indexed
+ * by page and slot, so xcalloc()/xfree() bookkeeping never writes the data
+ * pages (fork() CoW and swap friendly). One object per xcalloc(), payloads
+ * are 16 byte aligned; not tag accounted */
+vm_page_family_t *mm_instantiate_new_oob_family(char *struct_name, uint32_t struct_size);
+
+/* Sharded families: shard_count general families (shards) behind the
+ * registered name, 0 for one per CPU. xcalloc() allocates from the shard of
+ * the calling CPU, found through the thread's rseq area (sched_getcpu()
+ * without one), and takes a spare block from another shard before mapping a
+ * new vm page; xfree() returns the block to the shard that owns its page.
+ * Every shard operation holds that shard's mutex, so any thread may allocate
+ * and free; the rseq area is only read, there are no restartable sequences.
+ * A block split or a coalescing free does not end in the single store an
+ * rseq commit needs, and the uncontended lock is a small share of the pair
+ * (bench/bench_sharded.c).
+ * Limits and the pressure callback are set on the returned family and cover
+ * all of its shards; the callback runs without any shard lock held.
+ * mm_reserve() splits the reservation evenly */
+vm_page_family_t *mm_instantiate_new_sharded_family(char *struct_name, uint32_t struct_size,
+    uint32_t shard_count);
+
+/* Visit every live object of a family, pages in address order. The family
+ * must not change underneath, except a sharded one: each shard's objects are
+ * collected under its lock and visited without it, so cb may allocate from
+ * and free to the family (other threads must not free what is not yet
+ * visited). The parallel
+ * variant spreads the pages over up to n_workers threads (the caller
+ * included), so cb has to be thread safe. Both return the number of objects
+ * visited */
+uint64_t mm_for_each_object(vm_page_family_t *vm_page_family, mm_object_cb_t cb, void *ctx);
+uint64_t mm_parallel_for_each_object(vm_page_family_t *vm_page_family, mm_object_cb_t cb, void *ctx,
+    uint32_t n_workers);
+
+/* malloc style interface for arbitrary sizes, backed by size class families.
+ * Blocks are released with xfree(). Same threading rules as xcalloc(): the
+ * size class families are single owner like any other, which is why
+ * libmm_preload.so serialises every call on one global mutex. xmemalign()
+ * splits a size class block at the aligned address when the request fits
+ * one, bigger requests get a private mapping */
+void *xmalloc(size_t size);
+void *xmemalign(size_t alignment, size_t size);
+void *xrealloc(void *ptr, size_t size);
+size_t xmalloc_usable_size(void *ptr);
+
+/* Warm-up: prefault enough pages for n_objects single unit xcalloc()s and
+ * keep them mapped. Returns the number of pages the reservation holds */
+uint32_t mm_reserve(vm_page_family_t *vm_page_family, uint32_t n_objects);
+
+/* Register a const table of families at once, see MM_PAGE_FAMILY_REG() and
+ * MM_REG_STRUCT_STATIC() for load time registration. Returns how many were
+ * registered */
+uint32_t mm_register_page_families(const mm_page_family_reg_t *table, uint32_t count);
+
+/* Optional background maintenance thread, waking up every period_ms: unmaps
+ * the pages families gave up, keeps prefaulted pages ready for families that
+ * are growing and aggregates statistics. mm_maintenance_run_once() runs one
+ * pass by hand, with or without the thread; passes take turns */
+vm_bool_t mm_maintenance_start(uint32_t period_ms);
+void mm_maintenance_stop(void);
+void mm_maintenance_run_once(void);
+void mm_get_stats(mm_stats_t *stats);
+
+/* Memory pressure monitor, off until configured. cgroup_dir holds cgroup v2
+ * memory.current, memory.high and memory.events, psi_path a PSI memory file
+ * (/proc/pressure/memory or <cgroup>/memory.pressure); either may be NULL.
+ * mm_pressure_poll() reads them and reclaims by severity, the maintenance
+ * thread polls every period. Families no live thread owns (regions, shards,
+ * orphaned or only reserved ones) are trimmed by the poll, under their family
+ * lock; owned ones on their owner's next xcalloc(), or when the owner calls
+ * mm_page_family_trim() */
+vm_bool_t mm_pressure_monitor_configure(char *cgroup_dir, char *psi_path);
+mm_pressure_level_t mm_pressure_poll(void);
+vm_bool_t mm_register_shrink_callback(mm_shrink_cb_t cb, void *ctx);
+uint32_t mm_page_family_trim(vm_page_family_t *vm_page_family);
+
+/* Record every xcalloc()/xfree() to a binary trace file, see mm_trace.h and
+ * the mm_replay tool. Stop once the traced threads are quiescent */
+vm_bool_t mm_trace_start(char *path);
+void mm_trace_stop(void);
+
+/* Allocation tags: every object is charged to the calling thread's current
+ * tag (MM_TAG_UNTAGGED unless set), freed objects are credited back to the
+ * tag they were charged to, whichever thread frees them. Region families are
+ * not accounted; their vm pages are. Setting returns the previous tag.
+ * Each thread keeps its own charges and credits, mm_get_tag_stats() adds
+ * them up: exact while the other threads are quiescent, a snapshot otherwise */
+mm_tag_t mm_set_current_tag(mm_tag_t tag);
+mm_tag_t mm_get_current_tag(void);
+void *xcalloc_tagged(char *struct_name, int units, mm_tag_t tag);
+void mm_get_tag_stats(mm_tag_t tag, mm_tag_stats_t *stats);
+
+/* Off when callers serialise every xcalloc()/xfree() themselves */
+void mm_set_remote_free_mode(vm_bool_t enable);
+
+#ifdef __cplusplus
+}
+#endif
+
 #define MM_REG_STRUCT(struct_name) \
     (mm_instantiate_new_page_family(#struct_name, sizeof(struct_name)))
 
+#define MM_REG_STRUCT_WITH_LIMITS(struct_name, soft_limit_bytes, hard_limit_bytes) \
+    (mm_instantiate_new_page_family_with_limits(#struct_name, sizeof(struct_name), \
+        soft_limit_bytes, hard_limit_bytes))
+
+#define MM_REG_REGION_STRUCT(struct_name, warm_pages) \
+    (mm_instantiate_new_region_family(#struct_name, sizeof(struct_name), warm_pages))
+
+/* Load time registration: defines mm_page_family_<struct_name>, set up by a
+ * constructor before main(). Other files use MM_DECLARE_STRUCT_STATIC() and
+ * allocate with XCALLOC_STATIC(), which skips the name lookup */
+#define MM_REG_STRUCT_STATIC(struct_name, reserve_objects)                          \
+    vm_page_family_t *mm_page_family_##struct_name;                                 \
+    __attribute__((constructor)) static void mm_reg_static_##struct_name(void)      \
+    {                                                                               \
+        mm_page_family_reg_t reg = {(char *)#struct_name, sizeof(struct_name),      \
+                                    reserve_objects, &mm_page_family_##struct_name};\
+        mm_register_page_families(&reg, 1U);                                        \
+    }
+
+#define MM_DECLARE_STRUCT_STATIC(struct_name) \
+    extern vm_page_family_t *mm_page_family_##struct_name
+
+#define MM_PAGE_FAMILY_REG(struct_name, reserve_objects, page_family_ptr) \
+    {(char *)#struct_name, sizeof(struct_name), reserve_objects, page_family_ptr}
+
+#define XCALLOC_STATIC(units, struct_name) \
+    (xcalloc_page_family(mm_page_family_##struct_name, units))
+
+#define MM_REG_STRUCT_CTOR(struct_name, ctor, dtor) \
+    (mm_instantiate_new_cache_family(#struct_name, sizeof(struct_name), ctor, dtor))
+
+#define MM_REG_OOB_STRUCT(struct_name) \
+    (mm_instantiate_new_oob_family(#struct_name, sizeof(struct_name)))
+
+#define MM_REG_SHARDED_STRUCT(struct_name) \
+    (mm_instantiate_new_sharded_family(#struct_name, sizeof(struct_name), 0U))
+
 #define XCALLOC(uints, struct_name) \
     (xcalloc(#struct_name, uints))
 
+#define XCALLOC_NEAR(hint_ptr, units, struct_name) \
+    (xcalloc_near(hint_ptr, #struct_name, units))
+
 #define XFREE(ptr) \
     (xfree(ptr))
 